@@ -0,0 +1,217 @@
+
+/* █▄▄ █▀▀ █▄░█ █▀▀ █░█ */
+/* █▄█ ██▄ █░▀█ █▄▄ █▀█ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "common.h"
+#include "platform/platform.h"
+#include "bench.h"
+#include "cpu.h"
+#include "bus.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "debug.h"
+#include "jit.h"
+#include "gfx.h"
+#include "tiles.h"
+
+// T-cycles per second
+#define CPU_HZ 4194304
+
+// Passes over the whole tile set, or a whole frame of scanlines, in
+// the kernel microbenchmark
+#define BENCH_KERNEL_REPS 2000
+
+typedef struct Bench_Result {
+  double ips;   // instructions per second
+  double speed; // emulated time / real time
+  u64 retired;  // instructions actually run
+} Bench_Result;
+
+// Cpu options for one benchmark run
+typedef struct Bench_Config {
+  bool lazyFlags;
+  bool idleSkip;
+  bool blockCache;
+  bool jit;
+  bool lineRender;
+  bool idleReport;
+} Bench_Config;
+
+/* @Function Bench_Instructions
+ * @brief Boot a fresh machine on the ROM and time how long it takes
+ *    to execute instrs instructions. Execute may run a whole block, so
+ *    progress is measured by the Cpu's retired count. A ROM that stops
+ *    or halts for good ends the run early. ips is 0 if the ROM
+ *    couldn't be loaded. */
+static Bench_Result Bench_Instructions(std::string romFname, u32 instrs,
+    Bench_Config config) {
+  Scheduler sched;
+  Display disp;
+  Bus bus;
+  Ppu ppu(&bus, &disp);
+  Cpu cpu(&bus, &ppu, NULL);
+  Debugger debugger(&cpu, &bus, &ppu);
+
+  cpu.debugger = &debugger;
+  cpu.sched = &sched;
+  ppu.sched = &sched;
+  bus.cpu = &cpu;
+  disp.cpu = &cpu;
+  cpu.lazyFlags = config.lazyFlags;
+  cpu.idleSkip = config.idleSkip;
+  cpu.blockCache = config.blockCache;
+  ppu.lineRender = config.lineRender;
+
+  // Every run starts from blank cart RAM, and the player's save is
+  // never touched
+  if (bus.CopyRom(romFname, false) == FAILURE) return { 0, 0, 0 };
+
+  bus.Init();
+  cpu.Init();
+  ppu.Init();
+  if (config.jit) cpu.jit = new Jit(&cpu);
+
+  u64 lastRetired = 0;
+  u64 lastRetiredAt = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  while (cpu.retired < instrs && !cpu.Stopped()) {
+    cpu.Execute();
+
+    if (cpu.retired != lastRetired) {
+      lastRetired = cpu.retired;
+      lastRetiredAt = sched.now;
+    } else if (sched.now - lastRetiredAt > CPU_HZ) {
+      break;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  if (config.idleReport) cpu.IdleLoop_Report();
+  delete cpu.jit;
+
+  double secs = std::chrono::duration<double>(end - start).count();
+  return { cpu.retired / secs, sched.now / (double) CPU_HZ / secs, cpu.retired };
+}
+
+/* @Function Bench_Kernels
+ * @brief Time every row kernel the CPU supports on random tile data,
+ *    and check each one's output against the scalar kernels. */
+static void Bench_Kernels() {
+  static u8 planes[TILE_DATA_SIZE];
+  static u8 ids[TILE_COUNT * 64];
+  static u8 ref[TILE_COUNT * 64];
+  u8 line[SCREEN_WIDTH];
+  u32 argb[SCREEN_WIDTH];
+  u32 argbRef[SCREEN_WIDTH];
+  u32 lut[4] = { 0xFFE0F8D0, 0xFF88C070, 0xFF346856, 0xFF081820 };
+  u8 oam[GFX_OAM_SPRITES * 4];
+  u64 hitsRef[SCREEN_HEIGHT];
+
+  srand(1);
+  for (u32 i = 0; i < TILE_DATA_SIZE; i++) planes[i] = rand();
+  for (u16 i = 0; i < SCREEN_WIDTH; i++) line[i] = rand() & 0b11;
+  for (u16 i = 0; i < sizeof(oam); i++) oam[i] = rand() % 176;
+
+  const Gfx_Kernels & scalar = Gfx_Impls[0];
+  for (u16 t = 0; t < TILE_COUNT; t++) {
+    scalar.Decode(planes + t * TILE_BYTES, ref + t * 64, 8, true);
+  }
+  scalar.Map(line, lut, argbRef, SCREEN_WIDTH);
+  for (u16 y = 0; y < SCREEN_HEIGHT; y++) {
+    hitsRef[y] = scalar.ScanOam(oam, y, y & 1 ? 16 : 8);
+  }
+
+  for (int k = 0; k < GFX_IMPLS; k++) {
+    const Gfx_Kernels & impl = Gfx_Impls[k];
+    if (!impl.Supported()) continue;
+
+    auto start = std::chrono::steady_clock::now();
+    for (u32 rep = 0; rep < BENCH_KERNEL_REPS; rep++) {
+      for (u16 t = 0; t < TILE_COUNT; t++) {
+        impl.Decode(planes + t * TILE_BYTES, ids + t * 64, 8, rep & 1);
+      }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (u32 rep = 0; rep < BENCH_KERNEL_REPS; rep++) {
+      for (u16 y = 0; y < SCREEN_HEIGHT; y++) {
+        impl.Map(line, lut, argb, SCREEN_WIDTH);
+      }
+    }
+    auto scan = std::chrono::steady_clock::now();
+    bool hitsOk = true;
+    for (u32 rep = 0; rep < BENCH_KERNEL_REPS; rep++) {
+      for (u16 y = 0; y < SCREEN_HEIGHT; y++) {
+        u64 hits = impl.ScanOam(oam, y, y & 1 ? 16 : 8);
+        if (hits != hitsRef[y]) hitsOk = false;
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // The last decode pass was X-flipped, like ref
+    bool ok = memcmp(ids, ref, sizeof(ids)) == 0
+           && memcmp(argb, argbRef, sizeof(argb)) == 0
+           && hitsOk;
+
+    double decodeSecs = std::chrono::duration<double>(mid - start).count();
+    double mapSecs = std::chrono::duration<double>(scan - mid).count();
+    double scanSecs = std::chrono::duration<double>(end - scan).count();
+    double decodePx = (double) BENCH_KERNEL_REPS * TILE_COUNT * 64;
+    double mapPx = (double) BENCH_KERNEL_REPS * SCREEN_HEIGHT * SCREEN_WIDTH;
+    double scans = (double) BENCH_KERNEL_REPS * SCREEN_HEIGHT;
+
+    printf("Kernels (%s):%*s decode %8.1f Mpx/s, map %8.1f Mpx/s, "
+           "OAM scan %6.1f M/s%s\n",
+           impl.name, (int) (11 - strlen(impl.name)), "",
+           decodePx / decodeSecs / 1e6, mapPx / mapSecs / 1e6,
+           scans / scanSecs / 1e6, ok ? "" : "  MISMATCH");
+  }
+
+  Gfx_Init();
+  printf("Kernels in use:       %s\n", gfx.name);
+}
+
+/* @Function Bench_Run
+ * @brief Run the benchmarks on the given ROM and print the results. */
+int Bench_Run(std::string romFname, u32 instrs) {
+  printf("=== AMPHY BENCHMARK: %u instructions ===\n", instrs);
+
+  Bench_Result eager   = Bench_Instructions(romFname, instrs, { false, true, true, false, false, false });
+  Bench_Result lazy    = Bench_Instructions(romFname, instrs, { true, true, true, false, false, true });
+  Bench_Result noSkip  = Bench_Instructions(romFname, instrs, { true, false, true, false, false, false });
+  Bench_Result noBlock = Bench_Instructions(romFname, instrs, { true, true, false, false, false, false });
+  Bench_Result jit     = Bench_Instructions(romFname, instrs, { true, true, true, true, false, false });
+  Bench_Result line    = Bench_Instructions(romFname, instrs, { true, true, true, false, true, false });
+
+  if (eager.ips == 0 || lazy.ips == 0 || noSkip.ips == 0 ||
+      noBlock.ips == 0 || jit.ips == 0 || line.ips == 0) {
+    printf("ROM could not be loaded\n");
+    return EXIT_FAILURE;
+  }
+
+  for (const Bench_Result & r : { eager, lazy, noSkip, noBlock, jit, line }) {
+    if (r.retired < instrs) {
+      printf("ROM stopped or halted for good after %llu instructions\n",
+             (unsigned long long) r.retired);
+      break;
+    }
+  }
+
+  printf("Flags (eager):        %8.2f MIPS\n", eager.ips / 1e6);
+  printf("Flags (lazy):         %8.2f MIPS\n", lazy.ips / 1e6);
+  printf("Speedup:              %8.2fx\n", lazy.ips / eager.ips);
+  printf("Idle skip (off):      %8.2fx realtime\n", noSkip.speed);
+  printf("Idle skip (on):       %8.2fx realtime\n", lazy.speed);
+  printf("Block cache (off):    %8.2fx realtime\n", noBlock.speed);
+  printf("Block cache (on):     %8.2fx realtime\n", lazy.speed);
+  printf("JIT:                  %8.2fx realtime\n", jit.speed);
+  printf("Renderer (dot):       %8.2fx realtime\n", lazy.speed);
+  printf("Renderer (line):      %8.2fx realtime\n", line.speed);
+  Bench_Kernels();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,13 @@
+
+/* █▄▄ █▀▀ █▄░█ █▀▀ █░█ */
+/* █▄█ ██▄ █░▀█ █▄▄ █▀█ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include "common.h"
+
+int Bench_Run(std::string romFname, u32 instrs);
+
+#endif
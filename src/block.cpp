@@ -0,0 +1,196 @@
+
+/* █▄▄ █░░ █▀█ █▀▀ █▄▀ */
+/* █▄█ █▄▄ █▄█ █▄▄ █░█ */
+
+#include "block.h"
+#include "cpu.h"
+#include "bus.h"
+#include "jit.h"
+
+/* Instruction lengths, including the opcode. DD, ED and FD decode as
+ * CALL a16 and E4, EC, F4 and FC as CALL cc,a16 in this core, so they
+ * take 3 bytes. */
+static const u8 Op_Length[256] = {
+  // +0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F
+     1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 00+
+     2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 10+
+     2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 20+
+     2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 30+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 40+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 50+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 60+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 70+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 80+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 90+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // A0+
+     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // B0+
+     1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // C0+
+     1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1, // D0+
+     2, 1, 1, 1, 3, 1, 2, 1, 2, 1, 3, 1, 3, 3, 2, 1, // E0+
+     2, 1, 1, 1, 3, 1, 2, 1, 2, 1, 3, 1, 3, 3, 2, 1, // F0+
+};
+
+/* @Function Op_EndsBlock
+ * @brief Whether the instruction can jump, call, return, or change
+ *    the CPU state. Blocks end after these. */
+static bool Op_EndsBlock(u8 op) {
+  switch (op) {
+    case 0x10: // STOP
+    case 0x76: // HALT
+    case 0xFB: // EI
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+    case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+    case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL
+    case 0xDD: case 0xED: case 0xFD:
+    case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET
+    case 0xC7: case 0xCF: case 0xD7: case 0xDF: // RST
+    case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/* @Function BlockCache::Insert
+ * @brief Add an empty block for the code at host. RAM blocks are
+ *    remembered per page so writes can drop them. */
+Block * BlockCache::Insert(const u8 * host, u16 pc, bool ram) {
+  Block * block = &blocks[host];
+  block->pc = pc;
+  block->ops.clear();
+  block->runs = 0;
+
+  if (ram) ramBlocks[pc >> 8].push_back(host);
+  return block;
+}
+
+/* @Function BlockCache::Remove */
+void BlockCache::Remove(const u8 * host, u16 pc, bool ram) {
+  blocks.erase(host);
+  if (ram) {
+    std::vector<const u8 *> & keys = ramBlocks[pc >> 8];
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (keys[i] == host) {
+        keys[i] = keys.back();
+        keys.pop_back();
+        break;
+      }
+    }
+  }
+}
+
+/* @Function BlockCache::MarkCode
+ * @brief Record that a RAM block was decoded from [addr, addr+len).
+ *    Blocks never cross a page. */
+void BlockCache::MarkCode(u16 addr, u8 len) {
+  for (u8 i = 0; i < len; i++) {
+    ramCode[addr >> 8].set((addr + i) & 0xFF);
+  }
+}
+
+/* @Function BlockCache::Invalidate
+ * @brief Drop every block in a RAM page after one of its code bytes
+ *    was written. */
+void BlockCache::Invalidate(u8 page) {
+  for (const u8 * host : ramBlocks[page]) {
+    blocks.erase(host);
+  }
+  ramBlocks[page].clear();
+  ramCode[page].reset();
+  exit = true;
+}
+
+/* @Function Cpu::Block_Build
+ * @brief Decode the block starting at pc. It runs up to the first
+ *    control flow instruction, BLOCK_MAX_OPS instructions, or the end
+ *    of the page, whichever comes first. Returns NULL if not even the
+ *    first instruction fits in the page. */
+Block * Cpu::Block_Build(const u8 * host, Address pc, bool ram) {
+  Block * block = blocks.Insert(host, pc, ram);
+
+  u32 end = (pc | 0xFF) + 1;
+  if (pc >= HRAM_START) end = INTE;
+
+  u32 addr = pc;
+  while (addr < end && block->ops.size() < BLOCK_MAX_OPS) {
+    const u8 * code = host + (addr - pc);
+    u8 len = Op_Length[code[0]];
+    if (addr + len > end) break;
+
+    BlockOp bop;
+    bop.fn = opTable[code[0]];
+    bop.op = code[0];
+    bop.len = len;
+    bop.imm[0] = len > 1 ? code[1] : 0;
+    bop.imm[1] = len > 2 ? code[2] : 0;
+    block->ops.push_back(bop);
+
+    addr += len;
+    if (Op_EndsBlock(bop.op)) break;
+  }
+
+  if (block->ops.empty()) {
+    blocks.Remove(host, pc, ram);
+    return NULL;
+  }
+
+  // Writes to WRAM normally skip the slow path, so catch them there
+  if (ram) {
+    blocks.MarkCode(pc, addr - pc);
+    if (pc < HRAM_START) bus->ProtectPage(pc >> MAP_PAGE_SHIFT);
+  }
+
+  return block;
+}
+
+/* @Function Cpu::RunBlock
+ * @brief Run the block at pc. Instruction fetches come from the block
+ *    instead of the bus, but every instruction still ticks the same
+ *    cycles in the same places, and the block is left early wherever
+ *    Execute would have done something between instructions: an
+ *    interrupt is due, code was overwritten or remapped, or an IO
+ *    register was written. Code outside ROM, WRAM and HRAM is run one
+ *    instruction at a time. Hot ROM blocks are handed to the JIT if
+ *    there is one. */
+void Cpu::RunBlock() {
+  bool rom = pc < VRAM_START;
+  bool ram = (pc >= WRAM0_START && pc < ECHRAM_START)
+          || (pc >= HRAM_START && pc < INTE);
+
+  if (!rom && !ram) {
+    RunInstruction();
+    return;
+  }
+
+  const u8 * host = bus->GetAddressPointer(pc);
+  Block * block = blocks.Find(host);
+  if (!block) block = Block_Build(host, pc, ram);
+  if (!block) {
+    RunInstruction();
+    return;
+  }
+
+  block->runs++;
+  blocks.exit = false;
+
+  if (jit && !ram && block->runs == JIT_THRESHOLD) jit->Compile(block);
+  if (block->native) {
+    jit->runs++;
+    block->native(this, sched);
+    return;
+  }
+
+  // The block may be freed by an instruction in it; exit is set first
+  const BlockOp * ops = block->ops.data();
+  size_t n = block->ops.size();
+
+  for (size_t i = 0; i < n; i++) {
+    if (i > 0 && (blocks.exit || (ime && (*inte & *intf)))) break;
+
+    Tick(MEM_RW_CYCLES);
+    pc++;
+    op = ops[i].op;
+    (this->*ops[i].fn)();
+    retired++;
+  }
+}
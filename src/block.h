@@ -0,0 +1,75 @@
+
+/* █▄▄ █░░ █▀█ █▀▀ █▄▀ */
+/* █▄█ █▄▄ █▄█ █▄▄ █░█ */
+
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+
+// Pages are 256 bytes, same as the bus page tables
+#define BLOCK_PAGES 256
+
+// Longest run of instructions decoded into one block
+#define BLOCK_MAX_OPS 32
+
+class Cpu;
+class Scheduler;
+typedef void (Cpu::*OpHandler)();
+
+// Native code for a block, from the JIT
+typedef void (*BlockFn)(Cpu * cpu, Scheduler * sched);
+
+// One predecoded instruction
+typedef struct BlockOp {
+  OpHandler fn;   // opTable entry
+  u8 op;          // opcode
+  u8 len;         // bytes, including operands
+  u8 imm[2];      // operand bytes
+} BlockOp;
+
+// Straight-line run of instructions ending at the first one that
+// can change control flow, or at the end of the page
+typedef struct Block {
+  u16 pc;
+  std::vector<BlockOp> ops;
+  u32 runs = 0;
+  BlockFn native = NULL;
+} Block;
+
+/* Predecoded basic blocks, keyed by the host address of their first
+ * byte. A ROM address maps to a different host address in every bank,
+ * so this is effectively keyed by (bank, pc) and needs no flushing on
+ * bank switches. Blocks in RAM are dropped when their page is
+ * written. */
+class BlockCache
+{
+  private:
+    std::unordered_map<const u8 *, Block> blocks;
+
+    // Keys of blocks that start in each RAM page, and which bytes of
+    // the page they were decoded from
+    std::vector<const u8 *> ramBlocks[BLOCK_PAGES];
+    std::bitset<256> ramCode[BLOCK_PAGES];
+
+  public:
+    // Set when the running block may be stale (its code was
+    // overwritten or remapped, or it wrote to an IO register)
+    bool exit = false;
+
+    Block * Find(const u8 * host) {
+      auto it = blocks.find(host);
+      return it == blocks.end() ? NULL : &it->second;
+    }
+
+    Block * Insert(const u8 * host, u16 pc, bool ram);
+    void Remove(const u8 * host, u16 pc, bool ram);
+    void MarkCode(u16 addr, u8 len);
+    bool IsCode(u16 addr) { return ramCode[addr >> 8].test(addr & 0xFF); }
+    void Invalidate(u8 page);
+};
+
+#endif
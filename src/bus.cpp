@@ -7,68 +7,120 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "debug.h"
 #include "bus.h"
+#include "mbc.h"
 #include "cpu.h"
+#include "ppu.h"
 #include "common.h"
 
 bool testflag;
 
+Bus::~Bus() {
+  delete mbc;
+
+  if (romMapped) {
+    munmap(rom, romSize);
+  } else {
+    delete[] rom;
+  }
+
+  if (hasBattery) {
+    Save_Flush(true);
+    munmap(ext_ram, extRamSize);
+  } else {
+    delete[] ext_ram;
+  }
+}
+
+/* @Function HasBattery
+ * @brief Whether the cart type keeps its RAM across power cycles. */
+static bool HasBattery(u8 cartType) {
+  switch (cartType) {
+    case CT_MBC1_RAM_BAT:
+    case CT_MBC2_BAT:
+    case CT_ROM_RAM_BAT_1:
+    case CT_MMM01_RAM_BAT:
+    case CT_MBC3_TMR_BAT:
+    case CT_MBC3_TMR_RAM_BAT_2:
+    case CT_MBC3_RAM_BAT_2:
+    case CT_MBC5_RAM_BAT:
+    case CT_MBC5_RUM_RAM_BAT:
+    case CT_MBC7_SENSOR_RUM_RAM_BAT:
+    case CT_HuC1_RAM_BAT:
+      return true;
+    default:
+      return false;
+  }
+}
+
 void Bus::Init() {
-  cartType = rom_00.at(CART_TYPE);
+  cartType = rom[CART_TYPE];
   io_reg.at(TAC  - IO_START) = 0xF8;
   io_reg.at(LCDC - IO_START) = 0x91;
   io_reg.at(STAT - IO_START) = 0x81;
   io_reg.at(JOYP - IO_START) = 0xCF;
 
-  // Open rom for reading
-  // romFname = "src/bootix_dmg.bin";
-  // std::ifstream infile(romFname, std::ios::binary);
-  // 
-  // if (!infile.is_open()) {
-  //   printf("ROM could not be opened\n");
-  //   return;
-  // }
-
-  // std::vector<u8> const bootRom(
-  //    (std::istreambuf_iterator<char>(infile)),
-  //    (std::istreambuf_iterator<char>()));
-  // infile.close();
-
-  // // Copy 0000-3FFF to bank 0
-  // std::vector<u8>::const_iterator first = bootRom.begin();
-  // std::vector<u8>::const_iterator last = bootRom.begin() + 0x3FFF;
-  // rom_00.insert(rom_00.begin(), first, last);
+  MapMemory();
 
+  mbc = CreateMbc(this, cartType);
+  if (mbc->RamEnabled()) SwitchRamBank(0);
+
+  // LoadBootRom("src/bootix_dmg.bin");
   // cpu->pc = 0;
 }
 
-u8 Bus::Read(u16 address) const {
+/* @Function Bus::MapPages
+ * @brief Point the page table entries covering [start, start+size)
+ *    at consecutive 256-byte chunks of mem. A NULL mem unmaps them. */
+void Bus::MapPages(u16 start, u16 size, u8 * mem, bool writable) {
+  u8 first = start >> MAP_PAGE_SHIFT;
+  u16 count = size >> MAP_PAGE_SHIFT;
+
+  for (u16 i = 0; i < count; i++) {
+    readMap[first + i] = mem ? mem + (i << MAP_PAGE_SHIFT) : NULL;
+    writeMap[first + i] = writable ? readMap[first + i] : NULL;
+  }
+
+  // The running block may have been decoded from the old mapping
+  if (cpu) cpu->blocks.exit = true;
+}
+
+/* @Function Bus::MapMemory
+ * @brief Build the page tables. ROM is read-only (writes go to the
+ *    MBC), cart RAM is mapped by the MBC once enabled, and FE00-FFFF
+ *    is left to the slow path. VRAM writes take the slow path too,
+ *    so the PPU can catch up first. */
+void Bus::MapMemory() {
+  romBank0 = rom;
+  MapPages(ROM0_START,   0x4000, rom,            false);
+  MapPages(ROM1_START,   0x4000, rom + ROM_BANK_SIZE, false);
+  MapPages(VRAM_START,   0x2000, vram.data(),    false);
+  MapPages(WRAM0_START,  0x1000, wram_0.data(),  true);
+  MapPages(WRAM1_START,  0x1000, wram_1.data(),  true);
+  MapPages(ECHRAM_START, 0x1E00, ech_ram.data(), true);
+
+  if (bootRomMapped) {
+    MapPages(ROM0_START, 0x100, bootRom.data(), false);
+  }
+}
+
+/* @Function Bus::Read_Slow
+ * @brief Reads from pages with no page table entry. */
+u8 Bus::Read_Slow(u16 address) const {
   // Temporary for GBDoc
   // if (address == 0xFF44) return 0x90;
 
-  if (address < ROM1_START) {
-    return rom_00.at(address);
-  } else if (address < VRAM_START) {
-    return rom_01.at(address - ROM1_START);
-  } else if (address < EXTRAM_START) {
-    return vram.at(address - VRAM_START);
-  } else if (address < WRAM0_START) {
-    return ext_ram.at(address - EXTRAM_START);
-  } else if (address < WRAM1_START) {
-    return wram_0.at(address - WRAM0_START);
-  } else if (address < ECHRAM_START) {
-    return wram_1.at(address - WRAM1_START);
-  } else if (address < OAM_START) {
-    return ech_ram.at(address - ECHRAM_START);
-  } else if (address < INVALID_START) {
-    return oam.at(address - OAM_START);
-  } else if (address < IO_START) {
-    // fprintf(stderr, "Warning: Invalid memory region read: 0x%04x\n", address);
-    return 0xFF;
-  } else if (address < HRAM_START) {
-   
+  if (address >= HRAM_START && address < INTE) {
+    return hram[address - HRAM_START];
+  } else if (address >= IO_START && address < HRAM_START) {
+
     if (address == JOYP) {
       if (cpu->joypSelection == JOYP_SEL_ACT_VAL) {
         // printf("   Return act: %02X\n", (cpu->keyvec_act & 0x0F) | JOYP_SEL_ACT_VAL);
@@ -86,42 +138,66 @@ u8 Bus::Read(u16 address) const {
       }
     };
 
-    return io_reg.at(address - IO_START);
-  } else if (address < 0xFFFF) {
-    return hram.at(address - HRAM_START);    
-  } else if (address == 0xFFFF) {
+    // The timer is only brought up to date when it is looked at
+    if (address == DIV) return cpu->Sysclk() >> 8;
+    if (address == TIMA) cpu->Timer_Sync();
+
+    return io_reg[address - IO_START];
+  } else if (address == INTE) {
     return int_enable;
+  } else if (address >= OAM_START && address < INVALID_START) {
+    return oam[address - OAM_START];
+  } else if (address >= EXTRAM_START && address < WRAM0_START) {
+    return mbc->ReadRam(address);
   }
 
-  return FAILURE;
+  // fprintf(stderr, "Warning: Invalid memory region read: 0x%04x\n", address);
+  return 0xFF;
 }
 
-void Bus::Write(u16 address, u8 val) {
-  if (address == TIMA && cpu->doneTMAreload) return;
-
-  if (address < ROM1_START) {
-    MBC_Write(address, val);
-  } else if (address < VRAM_START) {
-    MBC_Write(address, val);
-  } else if (address < EXTRAM_START) {
-    vram.at(address - VRAM_START) = val;
-  } else if (address < WRAM0_START) {
-    ext_ram.at(address - EXTRAM_START) = val;
-  } else if (address < WRAM1_START) {
-    wram_0.at(address - WRAM0_START) = val;
-  } else if (address < ECHRAM_START) {
-    wram_1.at(address - WRAM1_START) = val;
-  } else if (address < OAM_START) {
-    ech_ram.at(address - ECHRAM_START) = val;
-  } else if (address < INVALID_START) {
-    oam.at(address - OAM_START) = val;
-  } else if (address < IO_START) {
-  } else if (address < HRAM_START) {
+/* @Function Bus::Write_Slow
+ * @brief Writes to pages with no page table entry. */
+void Bus::Write_Slow(u16 address, u8 val) {
+  if (address >= HRAM_START && address < INTE) {
+    hram[address - HRAM_START] = val;
+    if (cpu->blocks.IsCode(address)) {
+      cpu->blocks.Invalidate(address >> MAP_PAGE_SHIFT);
+    }
+  } else if (address >= IO_START && address < HRAM_START) {
+    cpu->blocks.exit = true;
     Write_MMIO(address, val);
-  } else if (address < 0xFFFF) {
-    hram.at(address - HRAM_START) = val;
-  } else if (address == 0xFFFF) {
+  } else if (address == INTE) {
     int_enable = val;
+  } else if (address < VRAM_START) {
+    MBC_Write(address, val);
+  } else if (address >= VRAM_START && address < EXTRAM_START) {
+    cpu->ppu->Sync();
+    vram[address - VRAM_START] = val;
+    if (address - VRAM_START < TILE_DATA_SIZE) {
+      cpu->ppu->tiles.Invalidate(address - VRAM_START);
+    }
+  } else if (address >= OAM_START && address < INVALID_START) {
+    cpu->ppu->Sync();
+    oam[address - OAM_START] = val;
+    cpu->ppu->OamWritten();
+  } else if (address >= WRAM0_START && address < ECHRAM_START) {
+    // WRAM page holding cached code. Once its code is overwritten the
+    // blocks are dropped and the page goes back to the fast path.
+    u8 page = address >> MAP_PAGE_SHIFT;
+    if (cpu->blocks.IsCode(address)) {
+      cpu->blocks.Invalidate(page);
+      writeMap[page] = readMap[page];
+    }
+    readMap[page][address & MAP_PAGE_MASK] = val;
+  } else if (address >= EXTRAM_START && address < WRAM0_START) {
+    // Battery RAM is mapped read-only so writes can be tracked
+    u8 * page = readMap[address >> MAP_PAGE_SHIFT];
+    if (page) {
+      page[address & MAP_PAGE_MASK] = val;
+      Save_MarkDirty(page + (address & MAP_PAGE_MASK) - ext_ram);
+    } else {
+      mbc->WriteRam(address, val);
+    }
   }
 }
 
@@ -140,11 +216,21 @@ void Bus::Write_MMIO(u16 address, u8 val) {
 
     case DIV: // any write clears
       io_reg.at(shiftedAddr) = 0;
-      cpu->sysclk = 0;
+      cpu->Timer_ResetDiv();
+      break;
+
+    // Ignored on the cycle TIMA is reloaded from TMA
+    case TIMA:
+      cpu->Timer_Sync();
+      if (cpu->sched->now == cpu->tmaReloadedAt) break;
+      io_reg.at(shiftedAddr) = val;
+      cpu->Timer_Schedule();
       break;
 
     case TAC: // only bit 0-2 writable
+      cpu->Timer_Sync();
       io_reg.at(shiftedAddr) = curVal | (val & 0b111);
+      cpu->Timer_Schedule();
       break;
 
     /* Writing to this changes what bits 0-3 represent
@@ -163,20 +249,51 @@ void Bus::Write_MMIO(u16 address, u8 val) {
       }
       break;
 
+    // Starting a transfer schedules its completion
+    case SERC:
+      io_reg.at(shiftedAddr) = val;
+      cpu->serial.Control(val);
+      break;
+
     // a write triggers DMA transfer
     // value is upper byte of start address
     case DMA:
-      cpu->doDMATransfer = true;
-      cpu->dmaAddr = val << 8;
-
-      cpu->dmaByteCnt = 0;
+      cpu->DMA_Start(val);
       io_reg.at(shiftedAddr) = val;
       break;
 
     // Bit 7 pulled high
     case STAT:
+      cpu->ppu->Sync();
       val |= 0x80;
       io_reg.at(shiftedAddr) = val;
+      cpu->ppu->Schedule();
+      break;
+
+    // The PPU may be behind. Catch it up before changing anything
+    // it draws with or that affects its interrupts.
+    case LCDC:
+    case SCY:
+    case SCX:
+    case LY:
+    case LYC:
+    case BGP:
+    case OBP0:
+    case OBP1:
+    case WY:
+    case WX:
+      cpu->ppu->Sync();
+      io_reg.at(shiftedAddr) = val;
+      cpu->ppu->Schedule();
+      break;
+
+    // Any write unmaps the boot ROM
+    case BOOT:
+      io_reg.at(shiftedAddr) = val;
+      if (bootRomMapped && val) {
+        bootRomMapped = false;
+        MapPages(ROM0_START, 0x100, romBank0, false);
+      }
       break;
 
     default:
@@ -186,128 +303,230 @@ void Bus::Write_MMIO(u16 address, u8 val) {
 }
 
 /* Bus::CopyRom
- * Copies ROM from .gb file to memory. */
-u8 Bus::CopyRom(std::string fname) {
-  // Open rom for reading
+ * Maps the whole ROM file into memory once. Bank switching only
+ * repoints page table entries into this image. Without useSave,
+ * battery carts get zeroed private RAM and the .sav is left alone. */
+u8 Bus::CopyRom(std::string fname, bool useSave) {
   romFname = fname;
-  std::ifstream infile(romFname, std::ios::binary);
-  
-  if (!infile.is_open()) {
+  int fd = open(romFname.c_str(), O_RDONLY);
+
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
     printf("ROM could not be opened\n");
+    if (fd >= 0) close(fd);
     return FAILURE;
   }
 
-  std::vector<u8> const rom_(
-     (std::istreambuf_iterator<char>(infile)),
-     (std::istreambuf_iterator<char>()));
-  infile.close();
+  romSize = st.st_size;
+
+  if (romSize >= ROM_MIN_SIZE) {
+    void * img = mmap(NULL, romSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (img != MAP_FAILED) {
+      rom = (u8 *) img;
+      romMapped = true;
+    }
+  }
 
-  // Copy 0000-3FFF to bank 0
-  std::vector<u8>::const_iterator first = rom_.begin();
-  std::vector<u8>::const_iterator last = rom_.begin() + 0x3FFF;
-  rom_00.insert(rom_00.begin(), first, last);
+  // Undersized (or unmappable) images get a padded heap copy so
+  // both banks are always backed
+  if (!romMapped) {
+    size_t fileSize = romSize;
+    if (romSize < ROM_MIN_SIZE) romSize = ROM_MIN_SIZE;
+    rom = new u8[romSize];
+    memset(rom, 0xFF, romSize);
+
+    ssize_t n = pread(fd, rom, fileSize, 0);
+    if (n < 0) {
+      printf("ROM could not be read\n");
+      close(fd);
+      return FAILURE;
+    }
+  }
 
-  // Copy 4000-7FFF to bank 1
-  first = rom_.begin() + 0x4000;
-  last = rom_.begin() + 0x7FFF;
-  rom_01.insert(rom_01.begin(), first, last);
+  close(fd);
 
-  cartType = rom_00.at(CART_TYPE);
+  romBanks = romSize / ROM_BANK_SIZE;
+  cartType = rom[CART_TYPE];
+
+  // 0: none, 1: unused (2 KiB), 2: 8 KiB, 3: 32 KiB, 4: 128 KiB, 5: 64 KiB
+  switch (rom[CART_RAM_SIZE]) {
+    case 3:  ramBanks = 4;  break;
+    case 4:  ramBanks = 16; break;
+    case 5:  ramBanks = 8;  break;
+    default: ramBanks = 1;  break;
+  }
+  extRamSize = ramBanks * RAM_BANK_SIZE;
+  if (cartType == CT_MBC2 || cartType == CT_MBC2_BAT) {
+    extRamSize = MBC2_RAM_SIZE;
+  }
+
+  hasBattery = useSave && HasBattery(cartType);
+  if (!hasBattery || OpenSave() == FAILURE) {
+    hasBattery = false;
+    ext_ram = new u8[extRamSize]();
+  }
 
   return SUCCESS;
 }
 
-/* Return a pointer to a memory value */
-u8 * Bus::GetAddressPointer(u16 address) {
-  std::vector <u8>::iterator it;
-  if (address <= 0x3FFF) {
-    it = rom_00.begin();
-  } else if (address <= 0x7FFF) {
-    it = rom_01.begin() + (address - 0x4000);
-  } else if (address <= 0x9FFF) {
-    it = vram.begin() + (address - 0x8000);
-  } else if (address <= 0xBFFF) {
-    it = ext_ram.begin() + (address - 0xA000);
-  } else if (address <= 0xCFFF) {
-    it = wram_0.begin() + (address - 0xC000);
-  } else if (address <= 0xDFFF) {
-    it = wram_1.begin() + (address - 0xD000);
-  } else if (address <= 0xFDFF) {
-    it = ech_ram.begin() + (address - 0xE000);
-  } else if (address <= 0xFE9F) {
-    it = oam.begin() + (address - 0xFE00);
-  } else if (address <= 0xFF7F) {
-    it = io_reg.begin() + (address - 0xFF00);
-  } else if (address <= 0xFFFE) {
-    it = hram.begin() + (address - 0xFF80);
-  } else if (address <= 0xFFFF) {
-    return &int_enable;
+/* Bus::OpenSave
+ * Maps <rom name>.sav as cart RAM, creating it if needed. */
+u8 Bus::OpenSave() {
+  size_t ext = romFname.find_last_of('.');
+  size_t dir = romFname.find_last_of('/');
+  if (ext == std::string::npos || (dir != std::string::npos && ext < dir)) {
+    saveFname = romFname + ".sav";
+  } else {
+    saveFname = romFname.substr(0, ext) + ".sav";
   }
-  return &(*it);
-}
 
-void Bus::MBC_Write(u16 addr, u8 v) {
-  switch (cartType) {
-    case CT_ROM_ONLY: break;
+  int fd = open(saveFname.c_str(), O_RDWR | O_CREAT, 0644);
 
-    case CT_MBC1:
-      // RAM enable
-      if (addr < 0x1FFF) {
-        ramEnable = v == 0xA; // not sure what this does
-      }
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    printf("Save file %s could not be opened\n", saveFname.c_str());
+    if (fd >= 0) close(fd);
+    return FAILURE;
+  }
 
-      // ROM bank number
-      else if (addr < 0x3FFF) {
-        v &= 0x1F; // only lower 5 bits used
-        if (v == 0x00 || v == 0x20 || v == 0x30 
-            || v == 0x40 || v == 0x60) v++;
-        SwitchBanks(v);
-      }
+  if ((size_t) st.st_size < extRamSize && ftruncate(fd, extRamSize) < 0) {
+    printf("Save file %s could not be resized\n", saveFname.c_str());
+    close(fd);
+    return FAILURE;
+  }
 
-      // RAM bank number
-      else if (addr < 0x5FFF) {
-      // TODO
-      }
+  void * mem = mmap(NULL, extRamSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
 
-      // Banking mode select
-      else if (addr < 0x7FFF) {
-      // TODO
-      }
+  if (mem == MAP_FAILED) {
+    printf("Save file %s could not be mapped\n", saveFname.c_str());
+    return FAILURE;
+  }
 
-      break;
-      
-    case CT_MBC2:
-      // If bit 8 set: RAM enable; else ROM bank number
-      if (addr < 0x3FFF) {
-        if (BIT_GET(v, 8)) {
-          if (v == 0) v++;
-          SwitchBanks(v & 0xF); // lower 4 bits specify bank
-        } else {
-          ramEnable = v == 0xA;
-        }
-      }
-      break;
+  ext_ram = (u8 *) mem;
+  hostPageSize = sysconf(_SC_PAGESIZE);
+  return SUCCESS;
+}
 
-    case CT_MBC3:
-      break;
+/* @Function Bus::Save_MarkDirty
+ * @brief Record that the host page holding ext_ram[offset] changed. */
+void Bus::Save_MarkDirty(u32 offset) {
+  if (!hasBattery) return;
+  saveDirty |= 1u << (offset / hostPageSize);
+}
+
+/* @Function Bus::Save_Tick
+ * @brief Called once per frame. Syncs dirty pages every saveInterval
+ *    frames. */
+void Bus::Save_Tick() {
+  if (!saveDirty || saveInterval == 0) return;
 
-    default: break;
+  if (++framesSinceSave >= saveInterval) {
+    Save_Flush(false);
   }
 }
-void Bus::SwitchBanks(u8 bankNum) {
-  // Open rom for reading
-  std::ifstream infile(romFname, std::ios::binary);
-  
-  std::vector<u8> const romfile_(
+
+/* @Function Bus::Save_Flush
+ * @brief msync runs of contiguous dirty pages. Without wait, this only
+ *    schedules the writeback (MS_ASYNC) so the emulation thread never
+ *    blocks on the disk. */
+void Bus::Save_Flush(bool wait) {
+  framesSinceSave = 0;
+  if (!hasBattery || !saveDirty) return;
+
+  u32 pages = (extRamSize + hostPageSize - 1) / hostPageSize;
+  u32 i = 0;
+
+  while (i < pages) {
+    if (!BIT_TEST(saveDirty, i)) {
+      ++i;
+      continue;
+    }
+
+    u32 first = i;
+    while (i < pages && BIT_TEST(saveDirty, i)) ++i;
+
+    size_t len = (i - first) * hostPageSize;
+    if (first * hostPageSize + len > extRamSize) {
+      len = extRamSize - first * hostPageSize;
+    }
+    msync(ext_ram + first * hostPageSize, len, wait ? MS_SYNC : MS_ASYNC);
+  }
+
+  saveDirty = 0;
+}
+
+/* Return a pointer to a memory value */
+u8 * Bus::GetAddressPointer(u16 address) {
+  u8 * page = readMap[address >> MAP_PAGE_SHIFT];
+  if (page) return page + (address & MAP_PAGE_MASK);
+
+  if (address < INVALID_START) {
+    return &oam[address - OAM_START];
+  } else if (address < HRAM_START) {
+    return &io_reg[address - IO_START];
+  } else if (address < INTE) {
+    return &hram[address - HRAM_START];
+  }
+  return &int_enable;
+}
+
+/* Bus::LoadBootRom
+ * Copies boot ROM from file and maps it over 0000-00FF. */
+u8 Bus::LoadBootRom(std::string fname) {
+  std::ifstream infile(fname, std::ios::binary);
+
+  if (!infile.is_open()) {
+    printf("Boot ROM could not be opened\n");
+    return FAILURE;
+  }
+
+  bootRom = std::vector<u8>(
      (std::istreambuf_iterator<char>(infile)),
      (std::istreambuf_iterator<char>()));
   infile.close();
+  bootRom.resize(0x100);
 
-  std::vector<u8>::const_iterator first = romfile_.begin();
-  first += (bankNum * BANK_SIZE);
+  bootRomMapped = true;
+  MapPages(ROM0_START, 0x100, bootRom.data(), false);
 
-  std::vector<u8>::const_iterator last = romfile_.begin() + 0x3FFF;
-  last += (bankNum * BANK_SIZE);
+  return SUCCESS;
+}
+
+void Bus::MBC_Write(u16 addr, u8 v) {
+  mbc->Write(addr, v);
+}
+
+/* @Function Bus::SwitchBanks
+ * @brief Map ROM bank bankNum into 4000-7FFF. */
+void Bus::SwitchBanks(u16 bankNum) {
+  bankNum %= romBanks;
+  MapPages(ROM1_START, 0x4000, rom + (bankNum * ROM_BANK_SIZE), false);
+}
+
+/* @Function Bus::SwitchBank0
+ * @brief Map ROM bank bankNum into 0000-3FFF (MBC1 RAM mode). */
+void Bus::SwitchBank0(u16 bankNum) {
+  bankNum %= romBanks;
+  romBank0 = rom + (bankNum * ROM_BANK_SIZE);
+  MapPages(ROM0_START, 0x4000, romBank0, false);
+
+  if (bootRomMapped) {
+    MapPages(ROM0_START, 0x100, bootRom.data(), false);
+  }
+}
+
+/* @Function Bus::SwitchRamBank
+ * @brief Map cart RAM bank bankNum into A000-BFFF. */
+void Bus::SwitchRamBank(u8 bankNum) {
+  bankNum %= ramBanks;
+  MapPages(EXTRAM_START, RAM_BANK_SIZE, ext_ram + (bankNum * RAM_BANK_SIZE), !hasBattery);
+}
 
-  rom_01.insert(rom_01.begin(), first, last);
+/* @Function Bus::DisableRam
+ * @brief Unmap A000-BFFF so accesses go to the MBC. Games disable RAM
+ *    once they finish saving, so this is also when the save is synced. */
+void Bus::DisableRam() {
+  MapPages(EXTRAM_START, RAM_BANK_SIZE, NULL, true);
+  Save_Flush(false);
 }
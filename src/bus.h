@@ -9,7 +9,10 @@
 
 // For MBC (CT == Cart Type)
 #define CART_TYPE 0x0147
-#define BANK_SIZE 0x2000
+#define CART_RAM_SIZE 0x0149
+#define ROM_BANK_SIZE 0x4000
+#define ROM_MIN_SIZE 0x8000
+#define RAM_BANK_SIZE 0x2000
 
 #define CT_ROM_ONLY         0x00 // done
 #define CT_MBC1             0x01 // done
@@ -54,28 +57,35 @@
 #define IO_START      0xFF00 // FF00-FF7F
 #define HRAM_START    0xFF80 // FF80-FFFE
 
-enum mbcModeSelect {
-  ROM_MODE,
-  RAM_MODE
-};
+// Page tables split the address space into 256 pages of 256 bytes
+#define MAP_PAGE_SHIFT 8
+#define MAP_PAGE_MASK  0xFF
+#define MAP_PAGES      256
 
 class Cpu;
+class Mbc;
 
 class Bus
 {
   private:
     // Memory map
-    // Rom bank 0. Fixed. 0000 - 3FFF
-    std::vector<u8> rom_00 = std::vector<u8>(16384);
-    
-    // Rom bank 1. Switchable. 4000 - 7FFF
-    std::vector<u8> rom_01 = std::vector<u8>(16384);
-    
+    // Whole cartridge image, mmap'd read-only. Rom bank 0 (0000-3FFF)
+    // is fixed; 4000-7FFF points at the selected bank.
+    u8 * rom = NULL;
+    size_t romSize = 0;
+    u16 romBanks = 0;
+    bool romMapped = false; // false if rom is a padded heap copy
+    u8 * romBank0 = NULL;   // bank currently mapped at 0000-3FFF
+
     // Video ram. 8000-9FFF
     std::vector<u8> vram = std::vector<u8>(8192);
     
     // From cart. Switchable. A000 - BFFF
-    std::vector<u8> ext_ram = std::vector<u8>(8192);
+    // Sized from the cart header; at least one bank. Battery-backed
+    // carts mmap this from the .sav file instead of the heap.
+    u8 * ext_ram = NULL;
+    size_t extRamSize = 0;
+    u8 ramBanks = 1;
     
     // C000 - CFFF
     std::vector<u8> wram_0 = std::vector<u8>(4096);
@@ -100,27 +110,81 @@ class Bus
     // Interrupt enable reg
     u8 int_enable;
 
+    // Boot ROM. Overlays 0000-00FF until a write to FF50.
+    std::vector<u8> bootRom;
+    bool bootRomMapped = false;
+
+    // Page tables. Each entry points to the host memory backing one
+    // 256-byte page. NULL entries fall back to Read_Slow/Write_Slow
+    // (MBC registers, VRAM writes, OAM, IO registers, HRAM and IE).
+    u8 * readMap[MAP_PAGES] = {};
+    u8 * writeMap[MAP_PAGES] = {};
+
   private:
     std::string romFname;
 
     // MBC
-    bool ramEnable = false;
+    Mbc * mbc = NULL;
     u8 cartType;
-    u8 mbcMode = ROM_MODE;
+
+    // Battery save. Writes to A000-BFFF take the slow path so the
+    // host pages they touch can be marked dirty; dirty pages are
+    // msync'd together every saveInterval frames or when the game
+    // disables cart RAM.
+    std::string saveFname;
+    bool hasBattery = false;
+    u32 saveDirty = 0; // one bit per host page of ext_ram
+    u32 framesSinceSave = 0;
+    long hostPageSize = 4096;
+
+    u8 OpenSave();
 
   public:
-    Cpu * cpu;
+    Cpu * cpu = NULL;
+
+    // Frames between save syncs. 0 syncs only on RAM disable and exit.
+    u32 saveInterval = 60;
+
+    ~Bus();
 
     void Init();
-    void Write(u16 address, u8 val);
     void Unrestricted_Write(u16 address, u8 val);
     void Write_MMIO(u16 address, u8 val);
     void MBC_Write(u16 address, u8 value);
-    void SwitchBanks(u8 bankNum);
-    u8 Read(u16 address) const;
+    void SwitchBanks(u16 bankNum);
+    void SwitchBank0(u16 bankNum);
+    void SwitchRamBank(u8 bankNum);
+    void DisableRam();
+    u8 * GetExtRam() { return ext_ram; }
+    void Save_MarkDirty(u32 offset);
+    void Save_Tick();
+    void Save_Flush(bool wait);
     u8 Unrestricted_Read(u16 address) const;
-    u8 CopyRom(std::string fname);
+    u8 CopyRom(std::string fname, bool useSave = true);
+    u8 LoadBootRom(std::string fname);
     u8 * GetAddressPointer(u16 address);
+    void ProtectPage(u8 page) { writeMap[page] = NULL; }
+
+    u8 inline Read(u16 address) const {
+      u8 * page = readMap[address >> MAP_PAGE_SHIFT];
+      if (page) return page[address & MAP_PAGE_MASK];
+      return Read_Slow(address);
+    }
+
+    void inline Write(u16 address, u8 val) {
+      u8 * page = writeMap[address >> MAP_PAGE_SHIFT];
+      if (page) {
+        page[address & MAP_PAGE_MASK] = val;
+        return;
+      }
+      Write_Slow(address, val);
+    }
+
+  private:
+    u8 Read_Slow(u16 address) const;
+    void Write_Slow(u16 address, u8 val);
+    void MapPages(u16 start, u16 size, u8 * mem, bool writable);
+    void MapMemory();
 };
 
 #endif
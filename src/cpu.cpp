@@ -10,14 +10,29 @@
 
 #include <cstdio>
 
+/* Scheduler callbacks */
+static void Timer_Event(void * ctx) {
+  Cpu * cpu = (Cpu *) ctx;
+  cpu->Timer_Sync();
+  cpu->Timer_Schedule();
+}
+
+static void DMA_Event(void * ctx) {
+  ((Cpu *) ctx)->DMA_Transfer();
+}
+
 void Cpu::Init() {
-  divPtr = bus->GetAddressPointer(DIV);
   joypPtr = bus->GetAddressPointer(JOYP);
   intf = bus->GetAddressPointer(INTF);
   inte = bus->GetAddressPointer(INTE);
   tima = bus->GetAddressPointer(TIMA);
   tma = bus->GetAddressPointer(TMA);
   tac = bus->GetAddressPointer(TAC);
+
+  sched->Register(EV_TIMER, Timer_Event, this);
+  sched->Register(EV_DMA, DMA_Event, this);
+  Timer_Schedule();
+  serial.Init(this);
 }
 
 /* @Function Cpu::Execute
@@ -27,7 +42,11 @@ void Cpu::Execute() {
 
   switch (cpuState) {
     case CPU_NORMAL:
-      RunInstruction();
+      if (blockCache && !gbdoc && !step) {
+        RunBlock();
+      } else {
+        RunInstruction();
+      }
       break;
 
     case CPU_EI:
@@ -39,13 +58,13 @@ void Cpu::Execute() {
       break;
 
     case CPU_HALT_IME_SET:
-      if (gbdoc || step) debugger->Step();
-      Tick(NOP_CYCLES);
-      break;
-
     case CPU_HALT_IME_NOT_SET:
-      if (gbdoc || step) debugger->Step();
-      Tick(NOP_CYCLES);
+      if (gbdoc || step) {
+        debugger->Step();
+        Tick(NOP_CYCLES);
+      } else {
+        Halt_FastForward();
+      }
       break;
 
     // Byte after halt is read twice
@@ -68,22 +87,15 @@ void Cpu::RunInstruction() {
     if (step) debugger->Step();
     if (gbdoc) debugger->Regdump();
     op = MemReadRaw(pc);
-    if (op == 0xCB) {
-      Decode16BitOpcode();
-    } else {
-      Decode8BitOpcode();
-    }
+    Decode();
   } else {
     op = MemReadRaw(pc);
     if (step) debugger->Step();
     if (gbdoc) debugger->Regdump();
     op = MemRead_u8(&pc);
-    if (op == 0xCB) {
-      Decode16BitOpcode();
-    } else {
-      Decode8BitOpcode();
-    }
+    Decode();
   }
+  retired++;
 }
 
 /* @Function Cpu::SetFlags 
@@ -92,6 +104,7 @@ void Cpu::RunInstruction() {
  * The upper 4 bits are the Z, N, HC, and C
  * flags (from msb to lsb). */
 void Cpu::SetFlags(u8 flags) {
+  lazy.op = LAZY_NONE;
   flags >>= 4;
   f.C  = flags & 0x1;
   f.HC = (flags >> 1) & 1;
@@ -100,6 +113,7 @@ void Cpu::SetFlags(u8 flags) {
 }
 
 void Cpu::SetFlags(bool z, bool n, bool hc, bool c) {
+  lazy.op = LAZY_NONE;
   f.Z = z;
   f.N = n;
   f.HC = hc;
@@ -113,6 +127,7 @@ void Cpu::SetFlags(bool z, bool n, bool hc, bool c) {
  *    (from msb to lsb). */
 u8 const Cpu::GetFlagsAsInt()
 {
+  Flags_Sync();
   return (f.Z << 7) | (f.N << 6) | (f.HC << 5) | (f.C << 4);
 }
 
@@ -120,21 +135,61 @@ u8 const Cpu::GetFlagsAsInt()
 /* █ █░▀█ ░█░ ██▄ █▀▄ █▀░ █▀█ █▄▄ ██▄ */
 
 /* @Function Cpu::Tick
- * @brief Ticks all other subsystems. */
+ * @brief Advances the cycle counter. Other subsystems only run
+ *    once the earliest scheduled deadline is reached. */
 void Cpu::Tick(u8 cycles) {
-  RunTimer(cycles);
-  ppu->Execute(cycles);
+  sched->now += cycles;
+  if (sched->now >= sched->next) sched->Run();
+}
+
+/* @Function Cpu::NextIrqCycle
+ * @brief Earliest cycle at which IF can change without the CPU
+ *    touching anything: the next timer event, DMA byte, serial
+ *    transfer completion, or PPU state transition/LY change. */
+u64 Cpu::NextIrqCycle() {
+  u64 until = ppu->IrqDeadline();
+
+  if (sched->Deadline(EV_TIMER) < until) until = sched->Deadline(EV_TIMER);
+  if (sched->Deadline(EV_DMA) < until) until = sched->Deadline(EV_DMA);
+  if (sched->Deadline(EV_SERIAL) < until) until = sched->Deadline(EV_SERIAL);
+
+  return until;
+}
+
+/* @Function Cpu::Halt_FastForward
+ * @brief Only the timer, DMA and PPU can change IF while halted. Jump
+ *    straight to the m-cycle where the first of them can raise an
+ *    interrupt and catch everything up at once, instead of ticking
+ *    through every m-cycle in between. */
+void Cpu::Halt_FastForward() {
+  u64 now = sched->now;
 
-  if (doDMATransfer) DMA_Transfer();
+  // Stay on the m-cycle grid
+  u64 target = (NextIrqCycle() + NOP_CYCLES - 1) / NOP_CYCLES * NOP_CYCLES;
+  if (target < now + NOP_CYCLES) target = now + NOP_CYCLES;
+
+  sched->now = target;
+  if (sched->now >= sched->next) sched->Run();
+}
+
+/* @Function Cpu::DMA_Start
+ * @brief Called on a write to the DMA register. The first byte is
+ *    copied on the next m-cycle. */
+void Cpu::DMA_Start(u8 page) {
+  dmaAddr = page << 8;
+  dmaByteCnt = 0;
+  sched->Schedule(EV_DMA, sched->now + MEM_RW_CYCLES);
 }
 
 /* @Function Cpu::DMA_Transfer 
- * @brief Called from Tick() function . Emulates DMA transfer 
-*   of sprite data from WRAM to OAM. */
+ * @brief Scheduled once per m-cycle while a DMA transfer is running.
+ *    Copies one byte of sprite data from WRAM to OAM. */
 void Cpu::DMA_Transfer() {
   u8 val = bus->Read(dmaAddr++);
   bus->Write(OAM_START + dmaByteCnt++, val);
-  if (dmaByteCnt == 160) doDMATransfer = false;
+  if (dmaByteCnt < 160) {
+    sched->Schedule(EV_DMA, sched->now + MEM_RW_CYCLES);
+  }
 }
 
 /* Memory read/write wrappers.
@@ -187,6 +242,83 @@ void Cpu::Push_u16(u16 value) {
 /* █▀▀ █░░ ▄▀█ █▀▀ █▀ */
 /* █▀░ █▄▄ █▀█ █▄█ ▄█ */
 
+/* @Function Cpu::Flags_Materialize
+ * @brief Compute Z/N/HC/C from the pending lazy op. Matches what
+ *    the eager versions of each op would have set. */
+void Cpu::Flags_Materialize()
+{
+  u8 x = lazy.x;
+  u8 y = lazy.y;
+  bool cin = lazy.cin;
+
+  f.Z = lazy.res == 0;
+
+  switch (lazy.op) {
+    case LAZY_ADD:
+      f.N = false;
+      f.HC = (x & 0xF) + (y & 0xF) > 0xF;
+      f.C = x + y > 0xFF;
+      break;
+    case LAZY_ADC:
+      f.N = false;
+      f.HC = (x & 0xF) + (y & 0xF) + cin > 0xF;
+      f.C = x + y + cin > 0xFF;
+      break;
+    case LAZY_SUB:
+    case LAZY_CP:
+      f.N = true;
+      f.HC = (y & 0xF) > (x & 0xF);
+      f.C = y > x;
+      break;
+    case LAZY_SBC:
+      f.N = true;
+      f.HC = (y & 0xF) + cin > (x & 0xF);
+      f.C = y + cin > x;
+      break;
+    case LAZY_AND:
+      f.N = false;
+      f.HC = true;
+      f.C = false;
+      break;
+    case LAZY_XOR:
+    case LAZY_OR:
+      f.N = false;
+      f.HC = false;
+      f.C = false;
+      break;
+
+    // C is left alone. It was synced before the op was recorded.
+    case LAZY_INC:
+      f.N = false;
+      f.HC = (x & 0xF) == 0xF;
+      break;
+    case LAZY_DEC:
+      f.N = true;
+      f.HC = (x & 0xF) == 0;
+      break;
+    default: break;
+  }
+
+  lazy.op = LAZY_NONE;
+}
+
+/* @Function Cpu::Flags_LazyC
+ * @brief Carry out of the pending lazy op. */
+bool Cpu::Flags_LazyC()
+{
+  switch (lazy.op) {
+    case LAZY_ADD: return lazy.x + lazy.y > 0xFF;
+    case LAZY_ADC: return lazy.x + lazy.y + lazy.cin > 0xFF;
+    case LAZY_SUB:
+    case LAZY_CP:  return lazy.y > lazy.x;
+    case LAZY_SBC: return lazy.y + lazy.cin > lazy.x;
+    case LAZY_AND:
+    case LAZY_XOR:
+    case LAZY_OR:  return false;
+    default:       return f.C;
+  }
+}
+
 /* ADDITION */
 /* C set for 16-bit addition when there is ovflw out of 16th bit. */
 void Cpu::SetFlags_16bitAdd_C(u16 x, u16 y)
@@ -239,204 +371,6 @@ void Cpu::SetFlags_8bitSub_HC(u8 x, u8 y)
   f.HC = ((x & 0xF) - (y & 0xF)) & 0x10;
 }
 
-/* █▀█ █▀█ █▀▀ █▀█ █▀▄ █▀▀ █▀ */
-/* █▄█ █▀▀ █▄▄ █▄█ █▄▀ ██▄ ▄█ */
-
-/* @Function Cpu::Decode8BitOpcode
- * @brief Algorithmic opcode decoding.
- * I don't know if it's faster than a table of function pointers
- * or a beeg switch/case, but I wanted to try it out.
- * https://gb-archive.github.io/salvage/decoding_gbz80_opcodes/Decoding%20Gamboy%20Z80%20Opcodes.html */
-void Cpu::Decode8BitOpcode()
-{
-  u8 x = op >> 6;            // Bit 6-7
-  u8 y = (op >> 3) & 0b111;  // Bit 3-5
-  u8 z = op & 0b111;         // Bit 0-2
-  u8 p = y >> 1;   // Bit 4-5
-  u8 q = y & 0b1;  // Bit 3
-
-  if (x == 0) {
-
-    // Relative jumps and assorted ops
-    if (z == 0) {
-      switch (y) {
-        case 0: break; // NOP: do nothing
-        case 1: LD_atNN_SP(); break;
-        case 2: STOP(); break;
-        case 3: JR_s8(); break;
-        case 4: 
-        case 5:
-        case 6:
-        case 7: JR_cc_s8(DT_cc[y-4], y & 0x1); break;
-        default: break;
-      }
-    }
-
-    // 16-bit load immediate/add
-    else if (z == 1)  {
-      if (q == 0) LD_rp_NN(p);
-      if (q == 1) ADD_HL_rp(p);
-    }
-   
-    // Indirect loading
-    else if (z == 2) {
-      if (q == 0) {
-        switch (p) {
-          case 0: LD_atBC_A(); break;
-          case 1: LD_atDE_A(); break;
-          case 2: LD_atHLi_A(); break;
-          case 3: LD_atHLd_A(); break;
-          default: break;
-        }
-      }
-
-      else if (q == 1) {
-        switch (p) {
-          case 0: LD_A_atBC(); break;
-          case 1: LD_A_atDE(); break;
-          case 2: LD_A_atHLi(); break;
-          case 3: LD_A_atHLd(); break;
-          default: break;
-        }
-      }
-    }
-  
-    // 16-bit INC/DEC
-    else if (z == 3) {
-      if (q == 0) INC_rp(p);
-      if (q == 1) DEC_rp(p);
-    }
-   
-    // 8-bit INC
-    else if (z == 4) INC_r(DT_r[y]);
-
-    // 8-bit DEC
-    else if (z == 5) DEC_r(DT_r[y]);
-
-    // 8-bit load immediate
-    else if (z == 6) LD_r_d8(DT_r[y]);
-
-    // Assorted operations on acc/flags
-    else if (z == 7) {
-      switch (y) {
-        case 0: RLCA(); break;
-        case 1: RRCA(); break;
-        case 2: RLA(); break;
-        case 3: RRA(); break;
-        case 4: DAA(); break;
-        case 5: CPL(); break;
-        case 6: SCF(); break;
-        case 7: CCF(); break;
-        default: break;
-      }
-    }
-  }
-
-  // 8-bit loading
-  else if (x == 1) {
-    if (z == 6 && y == 6) {
-      HALT();
-    } else {
-      LD_r1_r2(DT_r[y], DT_r[z]);
-    }
-  }
-
-  // ALU operations
-  else if (x == 2) ALU_r(DT_alu[y], DT_r[z]);
-
-  else if (x == 3) {
-    // Conditional return, mem-mapped register loads,
-    // and stack operations
-    if (z == 0) {
-      switch (y) {
-        case 0:
-        case 1:
-        case 2:
-        case 3:
-          RET_cc(DT_cc[y], y & 0x1);
-          break;
-        case 4: LD_a8_A();    break;
-        case 5: ADD_SP_s8();  break;
-        case 6: LD_A_a8();    break;
-        case 7: LD_HL_SPs8(); break;
-        default: break;
-      }
-    }
-
-    // POP & various ops
-    else if (z == 1) {
-      if (q == 0) {
-        POP_rp2(p);
-      } else {
-        if (p == 0) RET();
-        else if (p == 1) RETI();
-        else if (p == 2) JP_HL();
-        else if (p == 3) LD_SP_HL();
-      }
-    }
-
-    // Conditional jumps
-    else if (z == 2) {
-      switch(y) {
-        case 0:
-        case 1:
-        case 2:
-        case 3:
-          JP_cc_d16(DT_cc[y], y & 0x1);
-          break;
-        case 4: LD_atC_A();   break;
-        case 5: LD_a16_A(); break;
-        case 6: LD_A_atC();   break;
-        case 7: LD_A_a16(); break;
-        default: break;
-      }
-    }
-
-    // Assorted operations
-    else if (z == 3) {
-      if (y == 0) JP_nn();
-      else if (y == 6) DI();
-      else if (y == 7) EI();
-    }
-
-    // Conditional call
-    else if (z == 4) {
-      CALL_cc_a16(DT_cc[y], y & 0x1);
-    }
-
-    // PUSH & various ops
-    else if (z == 5) {
-      if (q == 0) PUSH_rp2(p);
-      else CALL_a16();
-    }
-
-    // Operate on accumulator and immediate operand
-    else if (z == 6) ALU_n(DT_alu[y]);
-
-    // Restart
-    else if (z == 7) RST_y(y * 8);
-  }
-}
-
-/* @Function Cpu::Decode16BitOpcode
- * @brief Algorithmic opcode decoding. */
-void Cpu::Decode16BitOpcode()
-{
-  op = MemRead_u8(&pc);
-
-  u8 x = op >> 6;            // Bit 6-7
-  u8 y = (op >> 3) & 0b111;  // Bit 3-5
-  u8 z = op & 0b111;         // Bit 0-2
-  u8 p = y >> 1;   // Bit 4-5
-  u8 q = y & 0b1;  // Bit 3
-
-  // Roll/shift register or mem location
-  if (x == 0) ROT_y_z(DT_rot[y], DT_r[z]);
-  else if (x == 1) BIT_y_r(y, DT_r[z]);
-  else if (x == 2) RES_y_r(y, DT_r[z]);
-  else if (x == 3) SET_y_r(y, DT_r[z]);
-}
-
 /* @Function Cpu::HandleInterrupt
  * @brief Check for and respond to interrupts 
  *    For an interrupt to occur: 
@@ -483,74 +417,311 @@ void Cpu::HandleInterrupt()
   }
 }
 
-/* @Function Cpu::RunTimer
- * @brief Ticks system clock and requests timer interrupt when
- * necessary.
+/* @Function Cpu::TimerPeriod
+ * @brief Cycles per TIMA increment for the current TAC. TIMA is
+ *    incremented whenever sysclk crosses a multiple of this. */
+u16 Cpu::TimerPeriod()
+{
+  switch(TAC_SELECT_MASK(*tac)) {
+    case TAC_1024:  return 0x400;
+    case TAC_16:    return 0x10;
+    case TAC_64:    return 0x40;
+    case TAC_256:   return 0x100;
+    default:        return 0x400;
+  }
+}
+
+/* @Function Cpu::Timer_Sync
+ * @brief Bring TIMA up to the current cycle. Counts the multiples
+ *    of the TAC period that sysclk crossed since the last sync,
+ *    instead of checking for an edge every m-cycle.
  *
- * Generally this is called within the Tick() function (which
- * is then called when there is an instruction with a memory
- * read/write or alu op). when cpu is halted, this is called
- * manually. */
-void Cpu::RunTimer(u8 cycles)
+ *    Called before TIMA is read or the timer registers are
+ *    written, and by the timer event on overflow/reload. */
+void Cpu::Timer_Sync()
 {
-  sysclk += cycles;
-  *divPtr = sysclk >> 8;
+  u64 now = sched->now;
+  if (now == timerSynced) return;
+
+  u64 from = timerSynced;
+  timerSynced = now;
+
+  // After overflow, TIMA contains 0 for 1 m-cycle before being
+  // reloaded with the value in TMA
+  if (tmaReloadAt <= now) {
+    *tima = *tma;
+    tmaReloadedAt = tmaReloadAt;
+    tmaReloadAt = EV_NEVER;
+  }
+
+  bool glitch = divGlitchAt > from && divGlitchAt <= now;
+  if (divGlitchAt <= now) divGlitchAt = EV_NEVER;
 
-  // TIMA is incremented at the frequency specified by TAC.
-  // When the value > 0xFF (overflows), it is reset to the value
-  // specified in TMA and an interrupt is requested.
   // Don't do anything if timer not enabled
-  if (!TAC_ENABLE_MASK(*tac)) {
-    oldSysclk = sysclk;
+  if (!TAC_ENABLE_MASK(*tac)) return;
+
+  u16 period = TimerPeriod();
+  u64 incs = (now + divOffset) / period - (from + divOffset) / period;
+  if (glitch && (divGlitchClk & period)) ++incs;
+  if (incs == 0) return;
+
+  // Request interrupt and reload TIMA from TMA if it overflows.
+  // The timer event fires on the overflow cycle, so this only
+  // ever happens with now as the overflow cycle.
+  if (*tima + incs > 0xFF) {
+    *tima = 0;
+    *intf = BIT_SET(*intf, INTF_TMR_IRQ);
+    tmaReloadAt = now + TMA_RELOAD;
+  } else {
+    *tima += incs;
+  }
+}
+
+/* @Function Cpu::Timer_Schedule
+ * @brief Schedule the timer event for the next cycle the timer
+ *    does something visible: a pending reload or the next overflow. */
+void Cpu::Timer_Schedule()
+{
+  u64 now = sched->now;
+
+  if (tmaReloadAt != EV_NEVER) {
+    sched->Schedule(EV_TIMER, tmaReloadAt);
+    return;
   }
 
-  if (doneTMAreload) doneTMAreload = false;
+  if (!TAC_ENABLE_MASK(*tac)) {
+    sched->Cancel(EV_TIMER);
+    return;
+  }
 
-  // TIMA reload
-  if (doTMAreload) {
-    tmaReload -= cycles;
-    if (tmaReload == 0) {
-      *tima = *tma;
-      doTMAreload = false;
+  u16 period = TimerPeriod();
+  u64 incs = 0x100 - *tima;
 
-      // helps prevent writes to tima while tima is
-      // reloading
-      doneTMAreload = true;
+  if (divGlitchAt > now && (divGlitchClk & period)) {
+    if (--incs == 0) {
+      sched->Schedule(EV_TIMER, divGlitchAt);
+      return;
     }
   }
 
-  // If tac_select has value TAC_1024, then it updates every
-  // 1024 clock cycles. log_2(1024) = 10. We can tell if 1024
-  // cycles have passed by checking if the 10th bit of sysclk
-  // changes state.
-  u16 tac_mask = 0;
-  switch(TAC_SELECT_MASK(*tac)) {
-    case TAC_1024:  tac_mask = 0x400; break;
-    case TAC_16:    tac_mask = 0x10;  break;
-    case TAC_64:    tac_mask = 0x40;  break;
-    case TAC_256:   tac_mask = 0x100; break;
+  u64 when = ((now + divOffset) / period + incs) * period - divOffset;
+  sched->Schedule(EV_TIMER, when);
+}
+
+/* @Function Cpu::Timer_NextIncrement
+ * @brief Next cycle TIMA changes on its own. */
+u64 Cpu::Timer_NextIncrement()
+{
+  if (tmaReloadAt != EV_NEVER) return tmaReloadAt;
+  if (!TAC_ENABLE_MASK(*tac)) return EV_NEVER;
+
+  u64 now = sched->now;
+  u16 period = TimerPeriod();
+  u64 next = ((now + divOffset) / period + 1) * period - divOffset;
+
+  if (divGlitchAt > now && divGlitchAt < next && (divGlitchClk & period)) {
+    next = divGlitchAt;
+  }
+  return next;
+}
+
+/* @Function Cpu::Timer_ResetDiv
+ * @brief Any write to DIV resets sysclk. If the bit selected by TAC
+ *    was set, TIMA sees a falling edge on the next m-cycle. */
+void Cpu::Timer_ResetDiv()
+{
+  Timer_Sync();
+
+  divGlitchClk = Sysclk();
+  divGlitchAt = sched->now + MEM_RW_CYCLES;
+  divOffset = -sched->now;
+
+  Timer_Schedule();
+}
+
+/* █ █▀▄ █░░ █▀▀    █░░ █▀█ █▀█ █▀█ █▀ */
+/* █ █▄▀ █▄▄ ██▄    █▄▄ █▄█ █▄█ █▀▀ ▄█ */
+
+/* @Function Cpu::IdleLoop_Match
+ * @brief Whether the loop from head back to the branch at branch is
+ *    a side-effect-free polling loop, e.g.
+ *        LDH A,(44h); CP 90h; JR NZ,head
+ *    It may read one PPU, timer or serial register into A, then only
+ *    run ops that compute A and F from A, then branch back. Every iteration
+ *    that reads the same value leaves the machine in the same state.
+ *    A loop that reads nothing must be a bare jump to itself, which
+ *    only an interrupt gets out of.
+ *
+ *    reg is set to the register polled (0 if none) and cycles to the
+ *    length of one iteration. */
+bool Cpu::IdleLoop_Match(Address head, Address branch, Address * reg, u8 * cycles)
+{
+  Address i = head;
+  u8 len = 0;
+  u8 op = bus->Read(i);
+
+  *reg = 0;
+
+  switch (op) {
+    case 0xF0: // LDH A,(a8)
+      *reg = 0xFF00 | bus->Read(i + 1);
+      i += 2;
+      len += 12;
+      break;
+    case 0xFA: // LD A,(a16)
+      *reg = bus->Read(i + 1) | (bus->Read(i + 2) << 8);
+      i += 3;
+      len += 16;
+      break;
+    case 0xF2: // LD A,(C)
+      *reg = 0xFF00 | BC.lo;
+      i += 1;
+      len += 8;
+      break;
     default: break;
   }
 
-  // XOR returns 1 if bits are different (state change). Then
-  // we mask with tac_mask to check if a specific bit changes state.
-  if ((oldSysclk ^ sysclk) & tac_mask) {
-    // Request interrupt and reset TIMA to value in TMA if
-    // overflow occurs. Increment normally otherwise.
-    if (*tima == 0xFF) {
-
-      // After overflow, TIMA contains 0 for 4 m-cycles before
-      // being reloaded with value from TMA register
-      doTMAreload = true;
-      tmaReload = TMA_RELOAD;
-      *tima = 0;
-      *intf = BIT_SET(*intf, INTF_TMR_IRQ);
-    } else {
-      (*tima)++;
+  if (*reg && *reg != LY && *reg != STAT && *reg != DIV && *reg != TIMA &&
+      *reg != SERC) {
+    return false;
+  }
+
+  while (i < branch) {
+    op = bus->Read(i);
+    switch (op) {
+      case 0xE6: // AND d8
+      case 0xEE: // XOR d8
+      case 0xF6: // OR d8
+      case 0xFE: // CP d8
+        i += 2;
+        len += 8;
+        break;
+      case 0xA7: // AND A
+      case 0xB7: // OR A
+        i += 1;
+        len += 4;
+        break;
+      case 0xCB: // BIT b,A
+        if ((bus->Read(i + 1) & 0xC7) != 0x47) return false;
+        i += 2;
+        len += 8;
+        break;
+      default:
+        return false;
     }
   }
 
-  oldSysclk = sysclk;
+  if (i != branch) return false;
+
+  op = bus->Read(branch);
+  bool conditional = true;
+  switch (op) {
+    case 0x18: conditional = false; // fallthrough
+    case 0x20: case 0x28: case 0x30: case 0x38:
+      len += 12;
+      break;
+    case 0xC3: conditional = false; // fallthrough
+    case 0xC2: case 0xCA: case 0xD2: case 0xDA:
+      len += 16;
+      break;
+    default:
+      return false;
+  }
+
+  if (!*reg && (conditional || branch != head)) return false;
+
+  *cycles = len;
+  return true;
+}
+
+/* @Function Cpu::IdleLoop_NextChange
+ * @brief Next cycle the polled register changes. A loop that polls
+ *    nothing stops at the next PPU transition so frames still get
+ *    presented. */
+u64 Cpu::IdleLoop_NextChange(Address reg)
+{
+  switch (reg) {
+    case LY:   return ppu->NextLyChange();
+    case DIV:  return sched->now + 0x100 - (Sysclk() & 0xFF);
+    case TIMA: return Timer_NextIncrement();
+    case SERC: {
+      // SC only changes when a transfer completes. With none running
+      // (an external clock), stop at PPU transitions as usual.
+      u64 done = sched->Deadline(EV_SERIAL);
+      u64 ppuNext = ppu->NextTransition();
+      return done < ppuNext ? done : ppuNext;
+    }
+    default:   return ppu->NextTransition();
+  }
+}
+
+/* @Function Cpu::IdleLoop_Check
+ * @brief Called after a taken backward branch, with pc at the loop
+ *    head. If this is a polling loop whose last iteration ran back to
+ *    back with the previous one and the polled register hasn't
+ *    changed, skip whole iterations up to the cycle the register (or
+ *    IF) can next change. */
+void Cpu::IdleLoop_Check(Address branch)
+{
+  if (!idleSkip || gbdoc || step) return;
+
+  Address reg;
+  u8 cycles;
+  if (!IdleLoop_Match(pc, branch, &reg, &cycles)) return;
+
+  u64 now = sched->now;
+  u8 val = reg ? bus->Read(reg) : 0;
+
+  bool steady = idle.pc == pc && idle.val == val && now - idle.at == cycles;
+  idle.pc = pc;
+  idle.val = val;
+  idle.at = now;
+
+  if (!steady || cpuState != CPU_NORMAL) return;
+
+  // A pending interrupt is taken before the next iteration
+  if (ime && (MemReadRaw(INTE) & MemReadRaw(INTF))) return;
+
+  // With IME off, IF changes can't break the loop, but the timer,
+  // DMA and serial port still have to run on their own cycles
+  u64 until = IdleLoop_NextChange(reg);
+  if (ime) {
+    if (NextIrqCycle() < until) until = NextIrqCycle();
+  } else {
+    if (sched->Deadline(EV_TIMER) < until) until = sched->Deadline(EV_TIMER);
+    if (sched->Deadline(EV_DMA) < until) until = sched->Deadline(EV_DMA);
+    if (sched->Deadline(EV_SERIAL) < until) until = sched->Deadline(EV_SERIAL);
+  }
+  if (until <= now) return;
+
+  // Every skipped iteration reads before the change, and nothing
+  // scheduled is passed over
+  u64 skip = (until - now) / cycles * cycles;
+  if (skip == 0) return;
+
+  sched->now += skip;
+  idle.at = sched->now;
+  if (sched->now >= sched->next) sched->Run();
+
+  IdleLoopStats * stats = &idleLoops[pc];
+  stats->cycles += skip;
+  stats->skips++;
+}
+
+/* @Function Cpu::IdleLoop_Report
+ * @brief Print how many cycles each detected idle loop saved. */
+void Cpu::IdleLoop_Report()
+{
+  u64 total = 0;
+
+  printf("=== IDLE LOOPS ===\n");
+  for (auto & [addr, stats] : idleLoops) {
+    printf("%04X: %llu cycles saved over %llu skips\n", addr,
+        (unsigned long long) stats.cycles,
+        (unsigned long long) stats.skips);
+    total += stats.cycles;
+  }
+  printf("Total: %llu cycles saved\n", (unsigned long long) total);
 }
 
 static const char* keytype_str[2] {
@@ -568,10 +739,12 @@ static const char* key_str[4] {
 /* @param type  keytype_dir or keytype_act
  * @param key   number 0-3 indicating key type
  * @brief 0 == pressed, so clear bit from corresponding key vector
- *    Also set interrupt flag when necessary */
+ *    Also set interrupt flag when necessary, and leave STOP */
 void Cpu::Key_Down(KeyType type, Keys key) {
   u8 * vec = (type == KEYTYPE_DIR) ? &keyvec_dir : &keyvec_act;
 
+  if (cpuState == CPU_STOP) cpuState = CPU_NORMAL;
+
   // Interrupt on high to low if corresponding keytype bit is selected
   u8 selBit, curType;
   selBit  = BIT_TEST(*joypPtr, JOYP_SEL_ACTION);
@@ -8,9 +8,15 @@
 #include <stdio.h>
 #include <array>
 #include <fstream>
+#include <map>
+#include <utility>
 #include <vector>
 
 #include "common.h"
+#include "scheduler.h"
+#include "block.h"
+#include "pacer.h"
+#include "serial.h"
 
 // Using t-cycles
 #define MEM_RW_CYCLES 4
@@ -73,7 +79,7 @@ typedef enum DT_ALU_Type {
   ALU_AND,    ALU_XOR,    ALU_OR,   ALU_CP,
 } DT_ALU_Type;
 
-const DT_ALU_Type DT_alu[8] = {
+constexpr DT_ALU_Type DT_alu[8] = {
   ALU_ADD_A,  ALU_ADC_A,  ALU_SUB,  ALU_SBC_A,
   ALU_AND,    ALU_XOR,    ALU_OR,   ALU_CP,
 };
@@ -83,11 +89,20 @@ typedef enum DT_Rot_Type {
   DT_SLA, DT_SRA, DT_SWAP, DT_SRL
 } DT_Rot_Type;
 
-const DT_Rot_Type DT_rot[8] = {
+constexpr DT_Rot_Type DT_rot[8] = {
   DT_RLC, DT_RRC, DT_RL,   DT_RR,
   DT_SLA, DT_SRA, DT_SWAP, DT_SRL
 };
 
+// Lazy flags: the last flag-setting ALU op, recorded in place of
+// computing Z/N/HC/C. Same order as DT_ALU_Type after LAZY_NONE.
+typedef enum Lazy_Op {
+  LAZY_NONE,
+  LAZY_ADD, LAZY_ADC, LAZY_SUB, LAZY_SBC,
+  LAZY_AND, LAZY_XOR, LAZY_OR,  LAZY_CP,
+  LAZY_INC, LAZY_DEC,
+} Lazy_Op;
+
 typedef enum Cpu_States {
   CPU_NORMAL,
   CPU_HALT_IME_SET,
@@ -110,19 +125,42 @@ typedef u16 Address;
 typedef u8 Register;
 typedef bool Flag;
 
+// 16-bit register pair. w is the pair, hi/lo are the 8-bit halves
+// (B/C, D/E, H/L), laid out to match host byte order.
+union RegPair {
+  u16 w;
+  struct {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    u8 lo;
+    u8 hi;
+#else
+    u8 hi;
+    u8 lo;
+#endif
+  };
+};
+static_assert(sizeof(RegPair) == 2, "RegPair must be packed");
+
+// Longest polling loop iteration the idle loop detector will skip
+#define IDLE_MAX_CYCLES 64
+
+// Cycles saved by one detected idle loop
+typedef struct IdleLoopStats {
+  u64 cycles = 0;
+  u64 skips = 0;
+} IdleLoopStats;
+
 class Bus;
 class Ppu;
 class Debugger;
+class Jit;
 
 class Cpu {
   private:
     u8 a = 0x01;
-    u8 b = 0x00;
-    u8 c = 0x13;
-    u8 d = 0x00;
-    u8 e = 0xD8;
-    u8 h = 0x01;
-    u8 l = 0x4D;
+    RegPair BC = { 0x0013 };
+    RegPair DE = { 0x00D8 };
+    RegPair HL = { 0x014D };
 
     struct f {
       bool Z = false;  // Zero
@@ -131,9 +169,17 @@ class Cpu {
       bool C = false;  // Carry
     } f;
 
+    // Pending op for lazy flags. f is stale while op != LAZY_NONE;
+    // Flags_Sync() folds the op into f.
+    struct lazy {
+      u8 op = LAZY_NONE;
+      u8 x = 0;   // operands
+      u8 y = 0;
+      u8 res = 0; // result (A - r for CP)
+      bool cin = false; // carry in for ADC/SBC
+    } lazy;
+
     u8 op = 0x00;
-    u16 sysclk = 0x00;
-    u16 oldSysclk = 0x00;
     u16 sp = 0xFFFE;
     u16 pc = 0x0100;
 
@@ -146,7 +192,6 @@ class Cpu {
   // Pointers to commonly used stuff
   // figured it might be faster than a whole call to bus->read
   private:
-    u8 * divPtr;
     u8 * joypPtr;
     u8 * intf;
     u8 * inte;
@@ -155,29 +200,113 @@ class Cpu {
     u8 * tac;
 
   private:
+    // F is kept as separate flags, so AF is assembled on demand
     u16 const inline af() { return (a << 8) | GetFlagsAsInt(); }
-    u16 const inline bc() { return b << 8 | c; }
-    u16 const inline de() { return d << 8 | e; }
-    u16 const inline hl() { return h << 8 | l; }
-
-    void inline af(u8 x, u8 y) { a = x; SetFlags(y); }
-    void inline bc(u8 x, u8 y) { b = x; c = y; }
-    void inline de(u8 x, u8 y) { d = x; e = y; }
-    void inline hl(u8 x, u8 y) { h = x; l = y; }
-
     void inline af(u16 x) { a = x >> 8; SetFlags(x & 0xFF); }
-    void inline bc(u16 x) { b = x >> 8; c = x & 0xFF; }
-    void inline de(u16 x) { d = x >> 8; e = x & 0xFF; }
-    void inline hl(u16 x) { h = x >> 8; l = x & 0xFF; }
 
     void SetFlags(bool z, bool n, bool hc, bool c);
     void SetFlags(u8 flags);
     u8 const GetFlagsAsInt();
 
-    void Decode8BitOpcode();
-    void Decode16BitOpcode();
+    void Flags_Materialize();
+    bool Flags_LazyC();
+
+    void Flags_Record(Lazy_Op op, u8 x, u8 y, u8 res, bool cin) {
+      lazy.op = op;
+      lazy.x = x;
+      lazy.y = y;
+      lazy.res = res;
+      lazy.cin = cin;
+    }
+
+    // Call before reading or partially updating f
+    void Flags_Sync() {
+      if (lazy.op != LAZY_NONE) Flags_Materialize();
+    }
+
+    // Z and C without materializing everything, for conditional
+    // jumps and carry-in
+    bool FlagZ() { return lazy.op == LAZY_NONE ? f.Z : lazy.res == 0; }
+    bool FlagC() { return lazy.op == LAZY_NONE ? f.C : Flags_LazyC(); }
+
+    // Table-driven decoding. Op<OP> decodes the x/y/z/p/q fields of
+    // the opcode at compile time, one instantiation per opcode.
+    template <u8 OP> void Op();
+    template <u8 OP> void Op_CB();
+    void Op_Prefix();
+
+    template <size_t... OP>
+    static constexpr std::array<OpHandler, 256> MakeOpTable(std::index_sequence<OP...>) {
+      return {{ &Cpu::Op<OP>... }};
+    }
+
+    template <size_t... OP>
+    static constexpr std::array<OpHandler, 256> MakeOpTable_CB(std::index_sequence<OP...>) {
+      return {{ &Cpu::Op_CB<OP>... }};
+    }
+
+    static const std::array<OpHandler, 256> opTable;
+    static const std::array<OpHandler, 256> opTable_CB;
+
+    void Decode() {
+      (this->*opTable[op])();
+    }
+
+    // Basic block cache
+    BlockCache blocks;
+    Block * Block_Build(const u8 * host, Address pc, bool ram);
+    void RunBlock();
+
+    // Register for index R of the r table: B C D E H L (HL) A.
+    // (HL) is a memory operand, so handlers deal with R == 6 themselves.
+    template <u8 R>
+    Register & Reg() {
+      static_assert(R < 8 && R != 6, "r index 6 is (HL)");
+      if constexpr (R == 0) return BC.hi;
+      else if constexpr (R == 1) return BC.lo;
+      else if constexpr (R == 2) return DE.hi;
+      else if constexpr (R == 3) return DE.lo;
+      else if constexpr (R == 4) return HL.hi;
+      else if constexpr (R == 5) return HL.lo;
+      else return a;
+    }
+
+    // Register pair for index P of the rp table: BC DE HL SP
+    template <u8 P>
+    u16 & RP() {
+      static_assert(P < 4, "rp index out of range");
+      if constexpr (P == 0) return BC.w;
+      else if constexpr (P == 1) return DE.w;
+      else if constexpr (P == 2) return HL.w;
+      else return sp;
+    }
+
+    // Condition for index CC of the cc table: NZ Z NC C.
+    // The unused CALL cc slots (E4 EC F4 FC) are never taken.
+    template <u8 CC>
+    bool Cond() {
+      if constexpr (CC < 2) return FlagZ() == (CC & 0x1);
+      else if constexpr (CC < 4) return FlagC() == (CC & 0x1);
+      else return false;
+    }
 
     void Tick(u8 cycles);
+    u64 NextIrqCycle();
+    void Halt_FastForward();
+
+    // Idle loop detection. Last polling loop seen, so a skip only
+    // happens once an iteration has run back to back with the
+    // polled register unchanged.
+    struct idle {
+      Address pc = 0;
+      u8 val = 0;
+      u64 at = 0;
+    } idle;
+    std::map<Address, IdleLoopStats> idleLoops;
+
+    bool IdleLoop_Match(Address head, Address branch, Address * reg, u8 * cycles);
+    u64 IdleLoop_NextChange(Address reg);
+    void IdleLoop_Check(Address branch);
 
     u8 MemReadRaw(Address addr);
     u8 MemRead_u8(Address * addr);
@@ -199,11 +328,18 @@ class Cpu {
     void SetFlags_8bitSub_HC(u8 x, u8 y);
 
     void HandleInterrupt();
-    void RunTimer(u8 cycles);
 
-    bool doTMAreload = false;
-    bool doneTMAreload = false;
-    u8 tmaReload = 0;
+    // Timer. TIMA is only brought up to date when it is read or
+    // written; the scheduler wakes the timer for overflows and reloads.
+    u16 divOffset = 0;           // sysclk is (now + divOffset)
+    u64 timerSynced = 0;         // cycle TIMA was last brought up to date
+    u64 tmaReloadAt = EV_NEVER;  // pending TIMA <- TMA after an overflow
+    u64 tmaReloadedAt = EV_NEVER;
+    u64 divGlitchAt = EV_NEVER;  // extra TIMA tick after a DIV write
+    u16 divGlitchClk = 0;        // sysclk at the time of that write
+
+    u16 TimerPeriod();
+    u64 Timer_NextIncrement();
 
     u8 joypSelection = JOYP_SEL_NIL_VAL;
     u8 keyvec_dir = 0x0F;
@@ -213,6 +349,11 @@ class Cpu {
     Bus * bus;
     Ppu * ppu;
     Debugger * debugger;
+    Scheduler * sched;
+    Jit * jit = NULL; // compiles hot blocks if set
+    Serial serial;
+
+    u64 retired = 0; // instructions executed, however they were run
 
   public:
     void Init();
@@ -220,12 +361,35 @@ class Cpu {
     void RunInstruction();
     void Key_Up(KeyType type, Keys key);
     void Key_Down(KeyType type, Keys key);
+    void IdleLoop_Report();
+
+    // In STOP nothing runs until a button is pressed
+    bool Stopped() { return cpuState == CPU_STOP; }
+
+    u16 Sysclk() { return sched->now + divOffset; }
+    void Timer_Sync();
+    void Timer_Schedule();
+    void Timer_ResetDiv();
+
+    void DMA_Start(u8 page);
+    void DMA_Transfer();
 
   // Flags
   public:
     bool gbdoc = false; // regdump
     bool step = false; // step 1 instruction
     bool doLog = false;
+    bool lazyFlags = true; // record ALU ops, compute flags when read
+    bool idleSkip = true; // fast-forward through register polling loops
+    bool blockCache = true; // run predecoded blocks instead of one instruction at a time
+    bool idleReport = false; // print cycles saved per idle loop on exit
+    bool useJit = false; // compile hot blocks to native code
+    u32 bench = 0; // run benchmarks for this many instructions, then exit
+    u32 jitDiff = 0; // compare JIT and interpreter for this many blocks, then exit
+    u32 frameLimit = 0; // quit after this many frames (0: run until closed)
+    double turbo = PACER_TURBO; // frame rate multiplier (0: unpaced)
+    bool paceReport = false; // print frame pacing statistics on exit
+    const char * serialPath = NULL; // send serial output here instead of stderr
 
   public:
     Cpu(Bus* bus_, Ppu* ppu_, Debugger * debugger_) {
@@ -236,30 +400,19 @@ class Cpu {
 
   /* Instructions */
   private:
-    /* Disassembly tables */
-    Flag * DT_cc[4] = {
-      &(f.Z), &(f.Z),
-      &(f.C), &(f.C),
-    };
-
-    // NULL is (HL) - handle manually within opcode
-    Register * DT_r[8] = {
-      &b, &c, &d,   &e,
-      &h, &l, NULL, &a,
-    };
-
-    bool doDMATransfer = false;
+    // Handlers taking a register, register pair (P), condition (CC),
+    // bit (N) or operation type are templates, so each opcode gets a
+    // body specialized for its operands.
     Address dmaAddr;
     u8 dmaByteCnt;
-    void DMA_Transfer();
 
     void NOP();
     void LD_atNN_SP();
     void STOP();
     void JR_s8();
-    void JR_cc_s8(Flag * f, bool cond);
-    void LD_rp_NN(u8 p);
-    void ADD_HL_rp(u8 p);
+    template <u8 CC> void JR_cc_s8();
+    template <u8 P> void LD_rp_NN();
+    template <u8 P> void ADD_HL_rp();
     void LD_atBC_A();
     void LD_atDE_A();
     void LD_atHLi_A();
@@ -268,11 +421,11 @@ class Cpu {
     void LD_A_atDE();
     void LD_A_atHLi();
     void LD_A_atHLd();
-    void INC_rp(u8 p);
-    void DEC_rp(u8 p);
-    void INC_r(Register * x);
-    void DEC_r(Register * x);
-    void LD_r_d8(Register * x);
+    template <u8 P> void INC_rp();
+    template <u8 P> void DEC_rp();
+    template <u8 R> void INC_r();
+    template <u8 R> void DEC_r();
+    template <u8 R> void LD_r_d8();
 	  void RLCA();
     void DAA();
 	  void RRCA();
@@ -281,20 +434,23 @@ class Cpu {
     void SCF();
 	  void RRA();
     void CCF();
-    void LD_r1_r2(Register * x, Register * y);
+    template <u8 R1, u8 R2> void LD_r1_r2();
     void HALT();
-    void ALU_r(DT_ALU_Type aluType, Register * r);
-    void RET_cc(Flag * flag, bool cond);
+    template <DT_ALU_Type T> void ALU(u8 val);
+    void Flags_INC(u8 val);
+    void Flags_DEC(u8 val);
+    template <DT_ALU_Type T, u8 R> void ALU_r();
+    template <u8 CC> void RET_cc();
     void LD_a8_A();
     void ADD_SP_s8();
     void LD_A_a8();
     void LD_HL_SPs8();
-    void POP_rp2(u8 p);
+    template <u8 P> void POP_rp2();
     void RET();
     void RETI();
     void JP_HL();
     void LD_SP_HL();
-    void JP_cc_d16(Flag * cc, bool cond);
+    template <u8 CC> void JP_cc_d16();
     void LD_A_atC();   
     void LD_a16_A(); 
     void LD_atC_A();   
@@ -302,15 +458,16 @@ class Cpu {
     void JP_nn();
     void EI();
     void DI();
-    void CALL_cc_a16(Flag * cc, bool cond);
-    void PUSH_rp2(u8 p);
+    template <u8 CC> void CALL_cc_a16();
+    template <u8 P> void PUSH_rp2();
     void CALL_a16();
-    void ALU_n(DT_ALU_Type aluType);
+    template <DT_ALU_Type T> void ALU_n();
     void RST_y(Address addr);
-    void ROT_y_z(DT_Rot_Type rotType, Register * x);
-    void BIT_y_r(u8 n, Register * x);
-    void RES_y_r(u8 n, Register * x);
-    void SET_y_r(u8 n, Register * x);
+    template <DT_Rot_Type T> u8 ROT(u8 val);
+    template <DT_Rot_Type T, u8 R> void ROT_y_z();
+    template <u8 N, u8 R> void BIT_y_r();
+    template <u8 N, u8 R> void RES_y_r();
+    template <u8 N, u8 R> void SET_y_r();
 
     // Mainly for debugging
     const char* opcode_8bit_names[256] = { 
@@ -335,6 +492,7 @@ class Cpu {
 
   friend class Bus;
   friend class Debugger;
+  friend class Jit;
 };
 
 #endif
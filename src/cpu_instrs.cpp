@@ -20,7 +20,7 @@ void Cpu::STOP() {
   u8 irq = MemReadRaw(INTF);
   u8 intrPending = ie & irq;
 
-  *divPtr = 0;
+  Timer_ResetDiv();
   cpuState = CPU_STOP;
 
   if (!intrPending) {
@@ -33,77 +33,62 @@ void Cpu::JR_s8() {
   int8_t s8 = MemRead_u8(&pc);
   Tick(ALU_CYCLES);
   pc += s8;
+  if (s8 < 0) IdleLoop_Check(pc - s8 - 2);
 }
 
 /* 20 28 30 38: JR cc s8 */
-void Cpu::JR_cc_s8(Flag * f, bool cond) {
+template <u8 CC>
+void Cpu::JR_cc_s8() {
   int8_t s8 = MemRead_u8(&pc);
-  if (*f == cond) {
+  if (Cond<CC>()) {
     Tick(ALU_CYCLES);
     pc += s8;
+    if (s8 < 0) IdleLoop_Check(pc - s8 - 2);
   }
 }
 
 /* 01 11 21 31: LD rp, d16 
  * Load 2 bytes of immediate data into register pair. */
-void Cpu::LD_rp_NN(u8 p) {
-  u8 lsb = MemRead_u8(&pc);
-  u8 msb = MemRead_u8(&pc);
-
-  switch (p) {
-    case 0: b = msb; c = lsb; break;
-    case 1: d = msb; e = lsb; break;
-    case 2: h = msb; l = lsb; break;
-    case 3: sp = (msb << 8) | lsb; break;
-    default: break;
-  }
+template <u8 P>
+void Cpu::LD_rp_NN() {
+  RP<P>() = MemRead_u16(&pc);
 }
 
 /* 09 19 29 39: ADD HL, rp */
-void Cpu::ADD_HL_rp(u8 p) {
-  u16 rp;
-  switch (p) {
-    case 0: rp = bc(); break;
-    case 1: rp = de(); break;
-    case 2: rp = hl(); break;
-    case 3: rp = sp; break;
-    default: break;
-  }
+template <u8 P>
+void Cpu::ADD_HL_rp() {
+  u16 rp = RP<P>();
 
   Tick(ALU_CYCLES);
+  Flags_Sync();
   f.N = false;
-  SetFlags_16bitAdd_C(rp, hl());
-  SetFlags_16bitAdd_HC(rp, hl());
+  SetFlags_16bitAdd_C(rp, HL.w);
+  SetFlags_16bitAdd_HC(rp, HL.w);
 
-  u16 sum = hl() + rp;
-  h = sum >> 8;
-  l = sum & 0xFF;
+  HL.w += rp;
 }
 
 /* 02: LD (BC), A */
 void Cpu::LD_atBC_A() {
-  Address addr = bc();
+  Address addr = BC.w;
   MemWrite_u8(&addr, a);
 }
 
 /* 12: LD (DE), A*/
 void Cpu::LD_atDE_A() {
-  Address addr = de();
+  Address addr = DE.w;
   MemWrite_u8(&addr, a);
 }
 
 /* 22: LD (HL+), A */
 void Cpu::LD_atHLi_A() {
-  Address addr = hl();
-  MemWrite_u8(&addr, a);
-  hl(addr);
+  MemWrite_u8(&HL.w, a);
 }
 
 /* 3A: LD (HL-), A */
 void Cpu::LD_atHLd_A() {
-  Address addr = hl();
-  MemWrite_u8(&addr, a);
-  hl(addr-2);
+  MemWrite_u8(&HL.w, a);
+  HL.w -= 2;
 }
 
 /* 0A: LD A, (BC)
@@ -111,134 +96,116 @@ void Cpu::LD_atHLd_A() {
  * register pair BC into register A.
  * */
 void Cpu::LD_A_atBC() {
-  Address addr = bc();
+  Address addr = BC.w;
   a = MemRead_u8(&addr);
 }
 
 /* 1A: LD A, (DE) */
 void Cpu::LD_A_atDE() {
-  Address addr = de();
+  Address addr = DE.w;
   a = MemRead_u8(&addr);
 }
 
 /* 2A: LD A, (HL+) */
 void Cpu::LD_A_atHLi() {
-  Address addr = hl();
-  a = MemRead_u8(&addr);
-  hl(addr);
+  a = MemRead_u8(&HL.w);
 }
 
 /* 3A: LD A, (HL-) */
 void Cpu::LD_A_atHLd() {
-  Address addr = hl();
-  a = MemRead_u8(&addr);
-  hl(addr - 2);
+  a = MemRead_u8(&HL.w);
+  HL.w -= 2;
 }
 
 /* 03 13 23 33: INC rp */
-void Cpu::INC_rp(u8 p) {
+template <u8 P>
+void Cpu::INC_rp() {
   Tick(ALU_CYCLES);
-  u16 rp;
-  switch(p) {
-    case 0: 
-      rp = bc();
-      bc(++rp);
-      break;
-    case 1:
-      rp = de();
-      de(++rp);
-      break;
-    case 2:
-      rp = hl();
-      hl(++rp);
-      break;
-    case 3:
-      ++sp;
-      break;
-    default: break;
-  }
-}
-
-/* 0B 1B 2B 3B: INC rp */
-void Cpu::DEC_rp(u8 p) {
+  ++RP<P>();
+}
+
+/* 0B 1B 2B 3B: DEC rp */
+template <u8 P>
+void Cpu::DEC_rp() {
   Tick(ALU_CYCLES);
-  u16 rp;
-  switch(p) {
-    case 0: 
-      rp = bc();
-      bc(--rp);
-      break;
-    case 1:
-      rp = de();
-      de(--rp);
-      break;
-    case 2:
-      rp = hl();
-      hl(--rp);
-      break;
-    case 3:
-      --sp;
-      break;
-    default: break;
-  }
+  --RP<P>();
 }
 
 /* 04 14 24 34 0C 1C 2C 3C: INC r */
-void Cpu::INC_r(Register * x) {
-  // (HL) handled manually
-  if (x == NULL) {
-    Address addr = hl();
+template <u8 R>
+void Cpu::INC_r() {
+  if constexpr (R == 6) {
+    Address addr = HL.w;
     u8 val = MemRead_u8(&addr);
-    SetFlags_8bitAdd_HC(val, 1);
-    val++;
-    f.N = false;
-    f.Z = val == 0;
-    addr = hl();
-    MemWrite_u8(&addr, val);
-    return;
+    Flags_INC(val);
+    addr = HL.w;
+    MemWrite_u8(&addr, val + 1);
+  } else {
+    Register & x = Reg<R>();
+    Flags_INC(x);
+    x++;
   }
-
-  SetFlags_8bitAdd_HC(*x, 1);
-  (*x)++;
-  f.N = false;
-  f.Z = *x == 0;
 }
 
 /* 05 15 25 35 0D 1D 2D 3D: DEC r */
-void Cpu::DEC_r(Register * x) {
-  // (HL) handled manually
-  if (x == NULL) {
-    Address addr = hl();
+template <u8 R>
+void Cpu::DEC_r() {
+  if constexpr (R == 6) {
+    Address addr = HL.w;
     u8 val = MemRead_u8(&addr);
-    addr = hl();
+    addr = HL.w;
     MemWrite_u8(&addr, val - 1);
+    Flags_DEC(val);
+  } else {
+    Register & x = Reg<R>();
+    Flags_DEC(x);
+    x--;
+  }
+}
 
-    f.N = true;
-    f.Z = (val-1) == 0;
-    SetFlags_8bitSub_HC(val, 1);
+/* @Function Cpu::Flags_INC
+ * @brief Flags for INC r. C is not affected. */
+void Cpu::Flags_INC(u8 val) {
+  Flags_Sync();
+
+  if (lazyFlags) {
+    Flags_Record(LAZY_INC, val, 1, val + 1, false);
+    return;
+  }
+
+  SetFlags_8bitAdd_HC(val, 1);
+  f.N = false;
+  f.Z = (u8) (val + 1) == 0;
+}
+
+/* @Function Cpu::Flags_DEC
+ * @brief Flags for DEC r. C is not affected. */
+void Cpu::Flags_DEC(u8 val) {
+  Flags_Sync();
+
+  if (lazyFlags) {
+    Flags_Record(LAZY_DEC, val, 1, val - 1, false);
     return;
   }
 
-  SetFlags_8bitSub_HC(*x, 1);
-  (*x)--;
+  SetFlags_8bitSub_HC(val, 1);
   f.N = true;
-  f.Z = *x == 0;
+  f.Z = (u8) (val - 1) == 0;
 }
 
 /* 06 0E 16 1E 26 2E 36 3E: LD r, d8
  * Load 8-bit immediate operand d8 into register R. */
-void Cpu::LD_r_d8(Register * x) {
+template <u8 R>
+void Cpu::LD_r_d8() {
   u8 d8 = MemRead_u8(&pc);
 
-  // (HL) handled separately
   // Store d8 into address (HL)
-  if (x == NULL) {
-    Address addr = hl();
+  if constexpr (R == 6) {
+    Address addr = HL.w;
     MemWrite_u8(&addr, d8);
-    return;
+  } else {
+    Reg<R>() = d8;
   }
-
-  *x = d8;
 }
 
 /* 07: RLCA
@@ -246,6 +213,7 @@ void Cpu::LD_r_d8(Register * x) {
  * The contents of bit 7 are placed in both the CY
  * flag and bit 0 of register A. */
 void Cpu::RLCA() {
+  Flags_Sync();
   u8 oldbit7 = a >> 7;
   a <<= 1;
   a |= oldbit7;
@@ -261,6 +229,7 @@ void Cpu::RLCA() {
  * Adjusts accumulator to correct BCD representation.
  * Sets carry flag if result > 0x99. */
 void Cpu::DAA() {
+  Flags_Sync();
   u16 correction = 0; 
   
   u8 HC = f.HC;
@@ -285,6 +254,7 @@ void Cpu::DAA() {
 /* 0F: RRCA
  * Rotate A right. Old bit 0 to CY and bit 7 of A. */
 void Cpu::RRCA() {
+  Flags_Sync();
   u8 oldbit0 = a & 0x1;
   a >>= 1;
   a |= (oldbit0 << 7);
@@ -298,6 +268,7 @@ void Cpu::RRCA() {
 /* 2F: CPL
  * Complement register A. */
 void Cpu::CPL() {
+  Flags_Sync();
   a = ~a;
   f.N = 1;
   f.HC = 1;
@@ -308,6 +279,7 @@ void Cpu::CPL() {
  * Then rotate that left. Old CY gets copied to bit 0.
  * Old bit 8 of A is discarded. */
 void Cpu::RLA() {
+  Flags_Sync();
   u8 oldCy = f.C;
   u8 oldbit7 = a >> 7;
   a <<= 1;
@@ -322,6 +294,7 @@ void Cpu::RLA() {
 /* 37: SCF
  * Set carry flag. */
 void Cpu::SCF() {
+  Flags_Sync();
   f.HC = 0;
   f.N = 0;
   f.C = 1;
@@ -332,6 +305,7 @@ void Cpu::SCF() {
  * Then rotate that right. Old CY gets copied to bit 7.
  * Old bit 0 of A is discarded. */
 void Cpu::RRA() {
+  Flags_Sync();
   u8 oldCy = f.C;
   u8 oldbit0 = a & 0x1;
   a >>= 1;
@@ -346,6 +320,7 @@ void Cpu::RRA() {
 /* 3F: CCF
 * Complement carry flag. */
 void Cpu::CCF() {
+  Flags_Sync();
   f.N = 0;
   f.HC = 0;
   f.C = !f.C;
@@ -353,20 +328,19 @@ void Cpu::CCF() {
 
 /* 40-7F: LD R1, R2
  * Set R1 = R2 */
-void Cpu::LD_r1_r2(Register * x, Register * y) {
-  // Handle (HL) manually
-  // Store contents of other register into (HL)
-  if (x != NULL && y == NULL) {
-    Address addr = hl();
-    *x = MemRead_u8(&addr);
-    return;
-  } else if (x == NULL & y != NULL) {
-    Address addr = hl();
-    MemWrite_u8(&addr, *y);
-    return;
+template <u8 R1, u8 R2>
+void Cpu::LD_r1_r2() {
+  static_assert(R1 != 6 || R2 != 6, "76 is HALT");
+
+  if constexpr (R2 == 6) {
+    Address addr = HL.w;
+    Reg<R1>() = MemRead_u8(&addr);
+  } else if constexpr (R1 == 6) {
+    Address addr = HL.w;
+    MemWrite_u8(&addr, Reg<R2>());
+  } else {
+    Reg<R1>() = Reg<R2>();
   }
-
-  *x = *y;
 }
 
 /* 76: HALT */
@@ -389,16 +363,42 @@ void Cpu::HALT() {
 }
 
 /* Operate on acc and register/memory location */
-void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
-  u8 reg;
-  if (r == NULL) {
-    Address addr = hl();
-    reg = MemRead_u8(&addr);
+template <DT_ALU_Type T, u8 R>
+void Cpu::ALU_r() {
+  if constexpr (R == 6) {
+    Address addr = HL.w;
+    ALU<T>(MemRead_u8(&addr));
   } else {
-    reg = *r;
+    ALU<T>(Reg<R>());
+  }
+}
+
+/* @Function Cpu::ALU
+ * @brief Shared by ALU r and ALU n: A = A <op> reg.
+ *    With lazyFlags, only the operands and result are recorded. */
+template <DT_ALU_Type T>
+void Cpu::ALU(u8 reg) {
+  if (lazyFlags) {
+    u8 x = a;
+    bool cin = false;
+    if constexpr (T == ALU_ADC_A || T == ALU_SBC_A) cin = FlagC();
+
+    u8 res;
+    if constexpr (T == ALU_ADD_A) res = x + reg;
+    else if constexpr (T == ALU_ADC_A) res = x + reg + cin;
+    else if constexpr (T == ALU_SUB) res = x - reg;
+    else if constexpr (T == ALU_SBC_A) res = x - reg - cin;
+    else if constexpr (T == ALU_AND) res = x & reg;
+    else if constexpr (T == ALU_XOR) res = x ^ reg;
+    else if constexpr (T == ALU_OR) res = x | reg;
+    else res = x - reg;
+
+    if constexpr (T != ALU_CP) a = res;
+    Flags_Record((Lazy_Op) (LAZY_ADD + T), x, reg, res, cin);
+    return;
   }
 
-  if (aluType == ALU_ADD_A) {
+  if constexpr (T == ALU_ADD_A) {
     SetFlags_8bitAdd_C(a, reg);
     SetFlags_8bitAdd_HC(a, reg);
     a += reg;
@@ -406,7 +406,7 @@ void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
     f.N = false;
 
   // A = Reg R + CY
-  } else if (aluType == ALU_ADC_A) {
+  } else if constexpr (T == ALU_ADC_A) {
     // Can't use SetFlags functions because they're
     // for adding only 2 numbers
     f.N = 0;
@@ -420,7 +420,7 @@ void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
     a = sum & 0xFF;
     f.Z = a == 0;
 
-  } else if (aluType == ALU_SUB) {
+  } else if constexpr (T == ALU_SUB) {
     SetFlags_8bitSub_C(a, reg);
     SetFlags_8bitSub_HC(a, reg);
     a -= reg;
@@ -428,7 +428,7 @@ void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
     f.N = true;
 
   // A = Reg R - CY
-  } else if (aluType == ALU_SBC_A) {
+  } else if constexpr (T == ALU_SBC_A) {
     // Can't use SetFlags functions because they're
     // for subtracting only 2 numbers
     f.N = true;
@@ -442,21 +442,21 @@ void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
     a = diff & 0xFF;
     f.Z = a == 0;
  
-  } else if (aluType == ALU_AND) {
+  } else if constexpr (T == ALU_AND) {
     a &= reg;
     f.Z = a == 0;
     f.N = 0;
     f.HC = 1;
     f.C = 0;
 
-  } else if (aluType == ALU_XOR) {
+  } else if constexpr (T == ALU_XOR) {
     a ^= reg;
     f.Z = a == 0;
     f.N = 0;
     f.HC = 0;
     f.C = 0;
 
-  } else if (aluType == ALU_OR) {
+  } else if constexpr (T == ALU_OR) {
     a |= reg;
     f.Z = a == 0;
     f.N = 0;
@@ -464,7 +464,7 @@ void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
     f.C = 0;
 
   // Compare Reg A and Reg r by checking A - r == 0
-  } else if (aluType == ALU_CP) {
+  } else if constexpr (T == ALU_CP) {
     SetFlags_8bitSub_C(a, reg);
     SetFlags_8bitSub_HC(a, reg);
     f.Z = (a - reg) == 0;
@@ -474,8 +474,9 @@ void Cpu::ALU_r(DT_ALU_Type aluType, Register * r) {
 
 /* C0 C8 D0 D8: RET cc
  * If flag is set, return from function. */
-void Cpu::RET_cc(Flag * flag, bool cond) {
-  if (*flag == cond) {
+template <u8 CC>
+void Cpu::RET_cc() {
+  if (Cond<CC>()) {
     u8 lsb = MemRead_u8(&sp);
     Tick(ALU_CYCLES);
     u8 msb = MemRead_u8(&sp);
@@ -503,6 +504,7 @@ void Cpu::LD_a8_A() {
  * Half-carry flag is set from bit 3 to 4 and carry is set
  * from bit 7 because it's treated as 2 8-bit ops. */
 void Cpu::ADD_SP_s8() {
+  Flags_Sync();
   int8_t i8 = MemRead_u8(&pc);
 
   u16 hc_sum = (sp & 0xF) + (i8 & 0xF);
@@ -524,6 +526,7 @@ void Cpu::LD_A_a8() {
 
 /* F8: LD HL, SP+s8 */
 void Cpu::LD_HL_SPs8() {
+  Flags_Sync();
   int8_t i8 = MemRead_u8(&pc);
 
   u16 hc_sum = (sp & 0xF) + (i8 & 0xF);
@@ -535,20 +538,16 @@ void Cpu::LD_HL_SPs8() {
   f.Z = 0;
   f.N = 0;
 
-  hl(sp + i8);
+  HL.w = sp + i8;
 }
 
 /* C1 D1 E1 F1: POP rp2 */
-void Cpu::POP_rp2(u8 p) {
+template <u8 P>
+void Cpu::POP_rp2() {
   u16 val = MemRead_u16(&sp);
 
-  switch (p) {
-    case 0: bc(val); break;
-    case 1: de(val); break;
-    case 2: hl(val); break;
-    case 3: af(val); break;
-    default: break;
-  }
+  if constexpr (P == 3) af(val);
+  else RP<P>() = val;
 }
 
 /* C9: RET
@@ -569,33 +568,36 @@ void Cpu::RETI() {
 
 /* E9: JP HL */
 void Cpu::JP_HL() {
-  pc = hl();
+  pc = HL.w;
 }
 
 /* F9: LD SP, HL */
 void Cpu::LD_SP_HL() {
-  sp = hl();
+  sp = HL.w;
   Tick(ALU_CYCLES);
 }
 
 /* C2 CA D2 DA: JP cc d16 */
-void Cpu::JP_cc_d16(Flag * cc, bool cond) {
+template <u8 CC>
+void Cpu::JP_cc_d16() {
   u16 newPc = MemRead_u16(&pc);
-  if (*cc == cond) {
+  if (Cond<CC>()) {
+    Address branch = pc - 3;
     pc = newPc;
     Tick(ALU_CYCLES);
+    if (newPc <= branch) IdleLoop_Check(branch);
   }
 }
 
 /* F2: LD A, (C) */
 void Cpu::LD_A_atC() {
-  Address addr = 0xFF00 | c;
+  Address addr = 0xFF00 | BC.lo;
   a = MemRead_u8(&addr);
 }
 
 /* E2: LD (C), A */
 void Cpu::LD_atC_A() {
-  Address addr = 0xFF00 | c;
+  Address addr = 0xFF00 | BC.lo;
   MemWrite_u8(&addr, a);
 }
 
@@ -613,8 +615,11 @@ void Cpu::LD_A_a16() {
 
 /* C4: JP a16 */
 void Cpu::JP_nn() {
-  pc = MemRead_u16(&pc);
+  u16 newPc = MemRead_u16(&pc);
+  Address branch = pc - 3;
+  pc = newPc;
   Tick(ALU_CYCLES);
+  if (newPc <= branch) IdleLoop_Check(branch);
 }
 
 /* FB: EI */
@@ -630,9 +635,10 @@ void Cpu::DI() {
 }
 
 /* C4 CC D4 DC CALL cc, a16 */
-void Cpu::CALL_cc_a16(Flag * cc, bool cond) {
+template <u8 CC>
+void Cpu::CALL_cc_a16() {
   u16 newPc = MemRead_u16(&pc);
-  if (*cc == cond) {
+  if (Cond<CC>()) {
     Push_u16(pc);
     pc = newPc;
     Tick(ALU_CYCLES);
@@ -640,14 +646,10 @@ void Cpu::CALL_cc_a16(Flag * cc, bool cond) {
 }
 
 /* C5 D5 E5 F5 PUSH rp2 */
-void Cpu::PUSH_rp2(u8 p) {
-  switch (p) {
-    case 0: Push_u16(bc()); break;
-    case 1: Push_u16(de()); break;
-    case 2: Push_u16(hl()); break;
-    case 3: Push_u16(af()); break; 
-    default: break;
-  }
+template <u8 P>
+void Cpu::PUSH_rp2() {
+  if constexpr (P == 3) Push_u16(af());
+  else Push_u16(RP<P>());
 }
 
 /* CD: CALL a16 */
@@ -659,9 +661,9 @@ void Cpu::CALL_a16() {
 }
 
 /* C6 CE D6 DE E6 EE F6 FE ALU n */
-void Cpu::ALU_n(DT_ALU_Type aluType) {
-  u8 d8 = MemRead_u8(&pc);
-  ALU_r(aluType, &d8);
+template <DT_ALU_Type T>
+void Cpu::ALU_n() {
+  ALU<T>(MemRead_u8(&pc));
 }
 
 /* C8 CF D8 DF E8 EF F8 FF RST_y */
@@ -675,14 +677,24 @@ void Cpu::RST_y(Address addr) {
 /* ▄█ █▄▄ ▄▄ █▄▄ █ ▀█▀    █▀█ █▀█ █▀ */
 /* ░█ █▄█ ░░ █▄█ █ ░█░    █▄█ █▀▀ ▄█ */
 
-void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
-  // If x is null, that means we should operate on (HL)
-  if (x == NULL) {
-    x = bus->GetAddressPointer(hl());
+template <DT_Rot_Type T, u8 R>
+void Cpu::ROT_y_z() {
+  if constexpr (R == 6) {
+    bus->Write(HL.w, ROT<T>(bus->Read(HL.w)));
+  } else {
+    Reg<R>() = ROT<T>(Reg<R>());
   }
+}
+
+/* @Function Cpu::ROT
+ * @brief Rotate/shift val, set flags, and return the result */
+template <DT_Rot_Type T>
+u8 Cpu::ROT(u8 val) {
+  u8 * x = &val;
+  Flags_Sync();
 
   // Rotate left
-  if (rot == DT_RLC) {
+  if constexpr (T == DT_RLC) {
     u8 oldbit7 = *x >> 7;
     *x <<= 1;
     *x |= oldbit7;
@@ -693,7 +705,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
   }
 
   // Rotate right
-  else if (rot == DT_RRC) {
+  else if constexpr (T == DT_RRC) {
     u8 oldbit0 = *x & 0x1;
     *x >>= 1;
     *x |= oldbit0 << 7;
@@ -704,7 +716,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
   }
 
   // Rotate left
-  else if (rot == DT_RL) {
+  else if constexpr (T == DT_RL) {
     u8 oldbit7 = *x >> 7;
     *x <<= 1;
     *x |= f.C;
@@ -716,7 +728,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
   }
 
   // Rotate right
-  else if (rot == DT_RR) {
+  else if constexpr (T == DT_RR) {
     u8 oldbit0 = *x & 0x1;
     *x >>= 1;
     *x |= f.C << 7;
@@ -726,7 +738,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
     f.N = 0;
   }
 
-  else if (rot == DT_SLA) {
+  else if constexpr (T == DT_SLA) {
     u8 bit7 = *x >> 7;
     f.C = bit7;
     *x <<= 1;
@@ -737,7 +749,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
     f.N = 0;
   }
 
-  else if (rot == DT_SRA) {
+  else if constexpr (T == DT_SRA) {
     u8 oldbit7 = *x >> 7;
     f.C = *x & 0x1;
     *x >>= 1;
@@ -748,7 +760,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
     f.N = 0;
   }
 
-  else if (rot == DT_SWAP) {
+  else if constexpr (T == DT_SWAP) {
     u8 old_lower4 = *x << 4;
     *x >>= 4; // move upper 4 to lower 4
     *x |= old_lower4;
@@ -759,7 +771,7 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
     f.N = 0;
   }
 
-  else if (rot == DT_SRL) {
+  else if constexpr (T == DT_SRL) {
     u8 oldbit0 = *x & 0x1;
     f.C = oldbit0;
     *x >>= 1;
@@ -770,42 +782,184 @@ void Cpu::ROT_y_z(DT_Rot_Type rot, Register * x) {
     f.HC = 0;
     f.N = 0;
   }
+
+  return val;
 }
 
-void Cpu::BIT_y_r(u8 n, Register * x) {
-  if (x == NULL) {
-    Address addr = hl();
-    x = bus->GetAddressPointer(hl());
-  }
+template <u8 N, u8 R>
+void Cpu::BIT_y_r() {
+  u8 x;
+  if constexpr (R == 6) x = bus->Read(HL.w);
+  else x = Reg<R>();
 
-  u8 val = (*x >> n) & 0x1;
+  u8 val = (x >> N) & 0x1;
+  Flags_Sync();
   f.Z = !val;
   f.N = 0;
   f.HC = 1;
 }
 
 /* Reset bit n of register x */
-void Cpu::RES_y_r(u8 n, Register * x) {
-  if (x == NULL) {
+template <u8 N, u8 R>
+void Cpu::RES_y_r() {
+  constexpr u8 mask = (0xFF ^ (0x1 << N));
+
+  if constexpr (R == 6) {
     Tick(MEM_RW_CYCLES);
-    x = bus->GetAddressPointer(hl());
+    bus->Write(HL.w, bus->Read(HL.w) & mask);
+  } else {
+    Reg<R>() &= mask;
   }
-    
-  u8 mask = (0xFF ^ (0x1 << n));
-  *x &= mask;
-
-  if (x == NULL) Tick(MEM_RW_CYCLES);
 }
 
-/* Reset bit y of register x */
-void Cpu::SET_y_r(u8 n, Register * x) {
-  if (x == NULL) {
-    Tick(MEM_RW_CYCLES);
-    x = bus->GetAddressPointer(hl());
-  }
-  
-  u8 mask = 0x1 << n;
-  *x |= mask;
+/* Set bit n of register x */
+template <u8 N, u8 R>
+void Cpu::SET_y_r() {
+  constexpr u8 mask = 0x1 << N;
 
-  if (x == NULL) Tick(MEM_RW_CYCLES);
-}
+  if constexpr (R == 6) {
+    Tick(MEM_RW_CYCLES);
+    bus->Write(HL.w, bus->Read(HL.w) | mask);
+  } else {
+    Reg<R>() |= mask;
+  }
+}
+
+/* █▀█ █▀█ █▀▀ █▀█ █▀▄ █▀▀ █▀ */
+/* █▄█ █▀▀ █▄▄ █▄█ █▄▀ ██▄ ▄█ */
+
+/* @Function Cpu::Op
+ * @brief Opcode decoding, done at compile time. The x/y/z/p/q fields
+ *    are constants, so each instantiation compiles down to a direct
+ *    call to one handler specialized for its operands.
+ * https://gb-archive.github.io/salvage/decoding_gbz80_opcodes/Decoding%20Gamboy%20Z80%20Opcodes.html */
+template <u8 OP>
+void Cpu::Op()
+{
+  constexpr u8 x = OP >> 6;
+  constexpr u8 y = (OP >> 3) & 0b111;
+  constexpr u8 z = OP & 0b111;
+  constexpr u8 p = y >> 1;
+  constexpr u8 q = y & 0b1;
+
+  if constexpr (x == 0) {
+    if constexpr (z == 0) {
+      if constexpr (y == 1) LD_atNN_SP();
+      else if constexpr (y == 2) STOP();
+      else if constexpr (y == 3) JR_s8();
+      else if constexpr (y >= 4) JR_cc_s8<y-4>();
+    }
+    else if constexpr (z == 1) {
+      if constexpr (q == 0) LD_rp_NN<p>();
+      else ADD_HL_rp<p>();
+    }
+    else if constexpr (z == 2) {
+      if constexpr (q == 0) {
+        if constexpr (p == 0) LD_atBC_A();
+        else if constexpr (p == 1) LD_atDE_A();
+        else if constexpr (p == 2) LD_atHLi_A();
+        else LD_atHLd_A();
+      } else {
+        if constexpr (p == 0) LD_A_atBC();
+        else if constexpr (p == 1) LD_A_atDE();
+        else if constexpr (p == 2) LD_A_atHLi();
+        else LD_A_atHLd();
+      }
+    }
+    else if constexpr (z == 3) {
+      if constexpr (q == 0) INC_rp<p>();
+      else DEC_rp<p>();
+    }
+    else if constexpr (z == 4) INC_r<y>();
+    else if constexpr (z == 5) DEC_r<y>();
+    else if constexpr (z == 6) LD_r_d8<y>();
+    else {
+      if constexpr (y == 0) RLCA();
+      else if constexpr (y == 1) RRCA();
+      else if constexpr (y == 2) RLA();
+      else if constexpr (y == 3) RRA();
+      else if constexpr (y == 4) DAA();
+      else if constexpr (y == 5) CPL();
+      else if constexpr (y == 6) SCF();
+      else CCF();
+    }
+  }
+
+  else if constexpr (x == 1) {
+    if constexpr (z == 6 && y == 6) HALT();
+    else LD_r1_r2<y, z>();
+  }
+
+  else if constexpr (x == 2) ALU_r<DT_alu[y], z>();
+
+  else {
+    if constexpr (z == 0) {
+      if constexpr (y <= 3) RET_cc<y>();
+      else if constexpr (y == 4) LD_a8_A();
+      else if constexpr (y == 5) ADD_SP_s8();
+      else if constexpr (y == 6) LD_A_a8();
+      else LD_HL_SPs8();
+    }
+    else if constexpr (z == 1) {
+      if constexpr (q == 0) POP_rp2<p>();
+      else if constexpr (p == 0) RET();
+      else if constexpr (p == 1) RETI();
+      else if constexpr (p == 2) JP_HL();
+      else LD_SP_HL();
+    }
+    else if constexpr (z == 2) {
+      if constexpr (y <= 3) JP_cc_d16<y>();
+      else if constexpr (y == 4) LD_atC_A();
+      else if constexpr (y == 5) LD_a16_A();
+      else if constexpr (y == 6) LD_A_atC();
+      else LD_A_a16();
+    }
+    else if constexpr (z == 3) {
+      if constexpr (y == 0) JP_nn();
+      else if constexpr (y == 6) DI();
+      else if constexpr (y == 7) EI();
+    }
+    else if constexpr (z == 4) CALL_cc_a16<y>();
+    else if constexpr (z == 5) {
+      if constexpr (q == 0) PUSH_rp2<p>();
+      else CALL_a16();
+    }
+    else if constexpr (z == 6) ALU_n<DT_alu[y]>();
+    else RST_y(y * 8);
+  }
+}
+
+/* @Function Cpu::Op_CB
+ * @brief Compile-time decoding for CB-prefixed opcodes. */
+template <u8 OP>
+void Cpu::Op_CB()
+{
+  constexpr u8 x = OP >> 6;
+  constexpr u8 y = (OP >> 3) & 0b111;
+  constexpr u8 z = OP & 0b111;
+
+  if constexpr (x == 0) ROT_y_z<DT_rot[y], z>();
+  else if constexpr (x == 1) BIT_y_r<y, z>();
+  else if constexpr (x == 2) RES_y_r<y, z>();
+  else SET_y_r<y, z>();
+}
+
+/* @Function Cpu::Op_Prefix
+ * @brief CB: fetch the second byte and dispatch through opTable_CB. */
+void Cpu::Op_Prefix()
+{
+  op = MemRead_u8(&pc);
+  (this->*opTable_CB[op])();
+}
+
+/* The CB entry of the base table is overwritten with Op_Prefix */
+static constexpr std::array<OpHandler, 256> WithPrefix(std::array<OpHandler, 256> table, OpHandler prefix) {
+  table[0xCB] = prefix;
+  return table;
+}
+
+const std::array<OpHandler, 256> Cpu::opTable =
+  WithPrefix(Cpu::MakeOpTable(std::make_index_sequence<256>()), &Cpu::Op_Prefix);
+
+const std::array<OpHandler, 256> Cpu::opTable_CB =
+  Cpu::MakeOpTable_CB(std::make_index_sequence<256>());
@@ -29,6 +29,7 @@ void Debugger::Regdump() {
   if (cpu->gbdoc) {
     printf("F:%02X ", cpu->GetFlagsAsInt());
   } else {
+    cpu->Flags_Sync();
     printf("F:%c%c%c%c ", 
       cpu->f.C ? 'C' : '-',
       cpu->f.HC ? 'H' : '-',
@@ -37,7 +38,7 @@ void Debugger::Regdump() {
   }
 
   printf("B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X ",
-      cpu->b, cpu->c, cpu->d, cpu->e, cpu->h, cpu->l);
+      cpu->BC.hi, cpu->BC.lo, cpu->DE.hi, cpu->DE.lo, cpu->HL.hi, cpu->HL.lo);
 
   printf("SP:%04X PC:%04X ",
       cpu->sp, cpu->pc);
@@ -182,7 +183,7 @@ void Debugger::PrintCpuState() {
       "IME: %s\n"   \
       "IE: %02X%s%s%s%s%s \n" \
       "IF: %02X%s%s%s%s%s \n" \
-      "OldSysclk/Sysclk: %X/%X\n", \
+      "Sysclk: %X\n", \
       Cpu_StatesStr[cpu->cpuState],
       (cpu->ime) ? "enabled" : "disabled",
       bus->Read(INTE),
@@ -197,8 +198,7 @@ void Debugger::PrintCpuState() {
       BIT_TEST(bus->Read(INTF), 2) ? " TMR" : "",
       BIT_TEST(bus->Read(INTF), 3) ? " SRL" : "",
       BIT_TEST(bus->Read(INTF), 4) ? " JOYP" : "",
-      cpu->oldSysclk,
-      cpu->sysclk
+      cpu->Sysclk()
       );
 }
 
@@ -0,0 +1,212 @@
+
+/* █▀▀ █▀▀ ▀▄▀ */
+/* █▄█ █▀░ █░█ */
+
+#include "gfx.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define GFX_X86
+  #include <immintrin.h>
+#endif
+
+/* █▀ █▀▀ ▄▀█ █░░ ▄▀█ █▀█ */
+/* ▄█ █▄▄ █▀█ █▄▄ █▀█ █▀▄ */
+
+static bool Scalar_Supported() { return true; }
+
+static void Scalar_Decode(const u8 * planes, u8 * ids, u8 rows, bool xflip) {
+  for (u8 row = 0; row < rows; row++) {
+    u8 lo = planes[row * 2];
+    u8 hi = planes[row * 2 + 1];
+    for (u8 col = 0; col < 8; col++) {
+      u8 bit = xflip ? col : 7 - col;
+      ids[row * 8 + col] = (BIT_GET(hi, bit) << 1) | BIT_GET(lo, bit);
+    }
+  }
+}
+
+static void Scalar_Map(const u8 * ids, const u32 * lut, u32 * argb, u16 n) {
+  for (u16 i = 0; i < n; i++) {
+    argb[i] = lut[ids[i]];
+  }
+}
+
+/* Y in OAM is the top line + 16. The top wraps to a byte, so sprites
+ * starting above the screen never match. */
+static u64 Scalar_ScanOam(const u8 * oam, u8 ly, u8 height) {
+  u64 hits = 0;
+  for (u8 i = 0; i < GFX_OAM_SPRITES; i++) {
+    u8 ypos = oam[i * 4] - 16;
+    if (ypos <= ly && ypos + height > ly) hits |= 1ULL << i;
+  }
+  return hits;
+}
+
+#ifdef GFX_X86
+
+/* █▀ █▀ █▀▀ ▀█ */
+/* ▄█ ▄█ ██▄ █▄ */
+
+/* Decode broadcasts each plane byte across 8 lanes and tests one bit
+ * per lane. Two rows fit in a register. There is no variable 32-bit
+ * shuffle before AVX2, and picking table entries with compare masks
+ * measured slower than the scalar lookup, so Map stays scalar.
+ * ScanOam keeps one OAM entry per 32-bit lane and tests 4 at a time. */
+
+static bool SSE2_Supported() { return __builtin_cpu_supports("sse2"); }
+
+__attribute__((target("sse2")))
+static void SSE2_Decode(const u8 * planes, u8 * ids, u8 rows, bool xflip) {
+  const __m128i bits = xflip
+    ? _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128)
+    : _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i two = _mm_set1_epi8(2);
+  const u64 spread = 0x0101010101010101ULL;
+
+  u8 row = 0;
+  for (; row + 2 <= rows; row += 2) {
+    const u8 * p = planes + row * 2;
+    __m128i lo = _mm_set_epi64x(p[2] * spread, p[0] * spread);
+    __m128i hi = _mm_set_epi64x(p[3] * spread, p[1] * spread);
+    __m128i l = _mm_cmpeq_epi8(_mm_and_si128(lo, bits), bits);
+    __m128i h = _mm_cmpeq_epi8(_mm_and_si128(hi, bits), bits);
+    __m128i v = _mm_or_si128(_mm_and_si128(l, one), _mm_and_si128(h, two));
+    _mm_storeu_si128((__m128i *) (ids + row * 8), v);
+  }
+
+  if (row < rows) {
+    Scalar_Decode(planes + row * 2, ids + row * 8, rows - row, xflip);
+  }
+}
+
+__attribute__((target("sse2")))
+static u64 SSE2_ScanOam(const u8 * oam, u8 ly, u8 height) {
+  const __m128i low = _mm_set1_epi32(0xFF);
+  const __m128i offset = _mm_set1_epi32(16);
+  const __m128i line = _mm_set1_epi32(ly);
+  const __m128i none = _mm_set1_epi32(-1);
+  const __m128i tall = _mm_set1_epi32(height);
+
+  u64 hits = 0;
+  for (u8 i = 0; i < GFX_OAM_SPRITES; i += 4) {
+    __m128i y = _mm_and_si128(_mm_loadu_si128((const __m128i *) (oam + i * 4)), low);
+    __m128i ypos = _mm_and_si128(_mm_sub_epi32(y, offset), low);
+    __m128i row = _mm_sub_epi32(line, ypos);
+    __m128i in = _mm_and_si128(_mm_cmpgt_epi32(row, none), _mm_cmplt_epi32(row, tall));
+    hits |= (u64) _mm_movemask_ps(_mm_castsi128_ps(in)) << i;
+  }
+  return hits;
+}
+
+/* ▄▀█ █░█ ▀▄▀ ▀█ */
+/* █▀█ ▀▄▀ █░█ █▄ */
+
+/* Same as SSE2 with four rows per register for Decode and 8 entries
+ * for ScanOam. Map is a single cross-lane permute of the table per 8
+ * pixels. */
+
+static bool AVX2_Supported() { return __builtin_cpu_supports("avx2"); }
+
+__attribute__((target("avx2")))
+static void AVX2_Decode(const u8 * planes, u8 * ids, u8 rows, bool xflip) {
+  const __m256i bits = xflip
+    ? _mm256_set1_epi64x(0x8040201008040201ULL)
+    : _mm256_set1_epi64x(0x0102040810204080ULL);
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i two = _mm256_set1_epi8(2);
+  const u64 spread = 0x0101010101010101ULL;
+
+  u8 row = 0;
+  for (; row + 4 <= rows; row += 4) {
+    const u8 * p = planes + row * 2;
+    __m256i lo = _mm256_set_epi64x(p[6] * spread, p[4] * spread,
+                                   p[2] * spread, p[0] * spread);
+    __m256i hi = _mm256_set_epi64x(p[7] * spread, p[5] * spread,
+                                   p[3] * spread, p[1] * spread);
+    __m256i l = _mm256_cmpeq_epi8(_mm256_and_si256(lo, bits), bits);
+    __m256i h = _mm256_cmpeq_epi8(_mm256_and_si256(hi, bits), bits);
+    __m256i v = _mm256_or_si256(_mm256_and_si256(l, one), _mm256_and_si256(h, two));
+    _mm256_storeu_si256((__m256i *) (ids + row * 8), v);
+  }
+
+  if (row < rows) {
+    SSE2_Decode(planes + row * 2, ids + row * 8, rows - row, xflip);
+  }
+}
+
+__attribute__((target("avx2")))
+static void AVX2_Map(const u8 * ids, const u32 * lut, u32 * argb, u16 n) {
+  const __m256i table = _mm256_setr_epi32(lut[0], lut[1], lut[2], lut[3],
+                                          lut[0], lut[1], lut[2], lut[3]);
+  u16 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadl_epi64((const __m128i *) (ids + i));
+    __m256i idx = _mm256_cvtepu8_epi32(v);
+    __m256i out = _mm256_permutevar8x32_epi32(table, idx);
+    _mm256_storeu_si256((__m256i *) (argb + i), out);
+  }
+
+  Scalar_Map(ids + i, lut, argb + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static u64 AVX2_ScanOam(const u8 * oam, u8 ly, u8 height) {
+  const __m256i low = _mm256_set1_epi32(0xFF);
+  const __m256i offset = _mm256_set1_epi32(16);
+  const __m256i line = _mm256_set1_epi32(ly);
+  const __m256i none = _mm256_set1_epi32(-1);
+  const __m256i tall = _mm256_set1_epi32(height);
+
+  u64 hits = 0;
+  for (u8 i = 0; i < GFX_OAM_SPRITES; i += 8) {
+    __m256i y = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (oam + i * 4)), low);
+    __m256i ypos = _mm256_and_si256(_mm256_sub_epi32(y, offset), low);
+    __m256i row = _mm256_sub_epi32(line, ypos);
+    __m256i in = _mm256_and_si256(_mm256_cmpgt_epi32(row, none), _mm256_cmpgt_epi32(tall, row));
+    hits |= (u64) _mm256_movemask_ps(_mm256_castsi256_ps(in)) << i;
+  }
+  return hits;
+}
+
+#else
+
+static bool SSE2_Supported() { return false; }
+static bool AVX2_Supported() { return false; }
+#define SSE2_Decode Scalar_Decode
+#define AVX2_Decode Scalar_Decode
+#define AVX2_Map Scalar_Map
+#define SSE2_ScanOam Scalar_ScanOam
+#define AVX2_ScanOam Scalar_ScanOam
+
+#endif
+
+const Gfx_Kernels Gfx_Impls[GFX_IMPLS] = {
+  { "scalar", Scalar_Supported, Scalar_Decode, Scalar_Map, Scalar_ScanOam },
+  { "SSE2",   SSE2_Supported,   SSE2_Decode,   Scalar_Map, SSE2_ScanOam },
+  { "AVX2",   AVX2_Supported,   AVX2_Decode,   AVX2_Map,   AVX2_ScanOam },
+};
+
+Gfx_Kernels gfx = Gfx_Impls[0];
+
+/* @Function Gfx_Init
+ * @brief Use the last (widest) implementation the CPU supports. */
+void Gfx_Init() {
+  for (int i = 0; i < GFX_IMPLS; i++) {
+    if (Gfx_Impls[i].Supported()) gfx = Gfx_Impls[i];
+  }
+}
+
+/* @Function Gfx_Argb */
+u32 Gfx_Argb(const Color * c) {
+  return 0xFF000000 | (c->r << 16) | (c->g << 8) | c->b;
+}
+
+/* @Function Gfx_PaletteLut
+ * @brief ARGB for each color index through a palette register
+ *    (BGP/OBP0/OBP1), 2 bits per index. */
+void Gfx_PaletteLut(u8 palette, const Color * colors, u32 * lut) {
+  for (u8 id = 0; id < 4; id++) {
+    lut[id] = Gfx_Argb(&colors[(palette >> (id * 2)) & 0b11]);
+  }
+}
@@ -0,0 +1,38 @@
+
+/* █▀▀ █▀▀ ▀▄▀ */
+/* █▄█ █▀░ █░█ */
+
+#ifndef GFX_H
+#define GFX_H
+
+#include "common.h"
+
+/* Row kernels for the renderers. Each implementation does the same
+ * thing; Gfx_Init picks the fastest one the host CPU supports. */
+typedef struct Gfx_Kernels {
+  const char * name;
+  bool (*Supported)();
+
+  // Expand rows of 2bpp tile data (low plane byte, then high) into 8
+  // color indices each, left to right, or right to left if xflip
+  void (*Decode)(const u8 * planes, u8 * ids, u8 rows, bool xflip);
+
+  // Look up n color indices (0-3) in a 4-entry ARGB table
+  void (*Map)(const u8 * ids, const u32 * lut, u32 * argb, u16 n);
+
+  // Bit i set if OAM entry i covers line ly, for sprites height tall
+  u64 (*ScanOam)(const u8 * oam, u8 ly, u8 height);
+} Gfx_Kernels;
+
+// Entries in OAM, 4 bytes each
+#define GFX_OAM_SPRITES 40
+
+#define GFX_IMPLS 3
+extern const Gfx_Kernels Gfx_Impls[GFX_IMPLS]; // scalar, SSE2, AVX2
+extern Gfx_Kernels gfx;                        // the one in use
+
+void Gfx_Init();
+u32 Gfx_Argb(const Color * c);
+void Gfx_PaletteLut(u8 palette, const Color * colors, u32 * lut);
+
+#endif
@@ -0,0 +1,465 @@
+
+/* ░░█ █ ▀█▀ */
+/* █▄█ █ ░█░ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "jit.h"
+#include "platform/platform.h"
+#include "cpu.h"
+#include "bus.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "debug.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+  #define JIT_X64
+  #include <sys/mman.h>
+#endif
+
+// x86 register numbers used in ModRM
+#define X_AL 0
+#define X_CL 1
+
+#define FIELD_OFF(base, field) ((u32) ((u8 *) &(field) - (u8 *) (base)))
+
+Jit::Jit(Cpu * cpu_) {
+  cpu = cpu_;
+
+  regOff[0] = FIELD_OFF(cpu, cpu->BC.hi);
+  regOff[1] = FIELD_OFF(cpu, cpu->BC.lo);
+  regOff[2] = FIELD_OFF(cpu, cpu->DE.hi);
+  regOff[3] = FIELD_OFF(cpu, cpu->DE.lo);
+  regOff[4] = FIELD_OFF(cpu, cpu->HL.hi);
+  regOff[5] = FIELD_OFF(cpu, cpu->HL.lo);
+  regOff[6] = 0;
+  regOff[7] = FIELD_OFF(cpu, cpu->a);
+
+  rpOff[0] = FIELD_OFF(cpu, cpu->BC.w);
+  rpOff[1] = FIELD_OFF(cpu, cpu->DE.w);
+  rpOff[2] = FIELD_OFF(cpu, cpu->HL.w);
+  rpOff[3] = FIELD_OFF(cpu, cpu->sp);
+
+  pcOff      = FIELD_OFF(cpu, cpu->pc);
+  retiredOff = FIELD_OFF(cpu, cpu->retired);
+  lazyOpOff  = FIELD_OFF(cpu, cpu->lazy.op);
+  lazyXOff   = FIELD_OFF(cpu, cpu->lazy.x);
+  lazyYOff   = FIELD_OFF(cpu, cpu->lazy.y);
+  lazyResOff = FIELD_OFF(cpu, cpu->lazy.res);
+  lazyCinOff = FIELD_OFF(cpu, cpu->lazy.cin);
+
+  nowOff  = FIELD_OFF(cpu->sched, cpu->sched->now);
+  nextOff = FIELD_OFF(cpu->sched, cpu->sched->next);
+
+#ifdef JIT_X64
+  void * mem = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    printf("JIT: could not map executable memory, interpreting\n");
+    full = true;
+  } else {
+    code = (u8 *) mem;
+  }
+#else
+  full = true;
+#endif
+}
+
+Jit::~Jit() {
+#ifdef JIT_X64
+  if (code) munmap(code, JIT_CODE_SIZE);
+#endif
+}
+
+/* █░█ █▀▀ █░░ █▀█ █▀▀ █▀█ █▀ */
+/* █▀█ ██▄ █▄▄ █▀▀ ██▄ █▀▄ ▄█ */
+
+/* Called from generated code. Plain functions so the code only needs
+ * their address. */
+
+void Jit::SchedRun(Scheduler * sched) {
+  sched->Run();
+}
+
+/* @Function Jit::Op
+ * @brief Run one instruction through the interpreter, the same way
+ *    RunBlock does. */
+void Jit::Op(Cpu * cpu, const BlockOp * o) {
+  cpu->Tick(MEM_RW_CYCLES);
+  cpu->pc++;
+  cpu->op = o->op;
+  (cpu->*o->fn)();
+}
+
+/* @Function Jit::Exit
+ * @brief Whether the block has to stop before its next instruction.
+ *    Same test as RunBlock. */
+bool Jit::Exit(Cpu * cpu) {
+  return cpu->blocks.exit || (cpu->ime && (*cpu->inte & *cpu->intf));
+}
+
+/* █▀▀ █▀▄▀█ █ ▀█▀ */
+/* ██▄ █░▀░█ █ ░█░ */
+
+/* Generated code keeps the Cpu in rbx, the Scheduler in r12, and sets
+ * r13b when a Tick ran the scheduler, since only then can an
+ * interrupt have become pending during a native instruction. */
+
+void Jit::Emit(std::initializer_list<u8> bytes) {
+  buf.insert(buf.end(), bytes);
+}
+
+void Jit::Emit32(u32 val) {
+  for (int i = 0; i < 4; i++) buf.push_back(val >> (i * 8));
+}
+
+void Jit::Emit64(u64 val) {
+  for (int i = 0; i < 8; i++) buf.push_back(val >> (i * 8));
+}
+
+// mov rax, fn; call rax
+void Jit::EmitCall(void * fn) {
+  Emit({ 0x48, 0xB8 });
+  Emit64((u64) fn);
+  Emit({ 0xFF, 0xD0 });
+}
+
+// mov reg8, [rbx+off]
+void Jit::EmitLoad(u8 reg, u32 off) {
+  Emit({ 0x8A, (u8) (0x83 | (reg << 3)) });
+  Emit32(off);
+}
+
+// mov [rbx+off], reg8
+void Jit::EmitStore(u32 off, u8 reg) {
+  Emit({ 0x88, (u8) (0x83 | (reg << 3)) });
+  Emit32(off);
+}
+
+// mov byte [rbx+off], imm
+void Jit::EmitStoreImm(u32 off, u8 imm) {
+  Emit({ 0xC6, 0x83 });
+  Emit32(off);
+  Emit({ imm });
+}
+
+// add word [rbx+off], imm (sign extended)
+void Jit::EmitAddWord(u32 off, u8 imm) {
+  Emit({ 0x66, 0x83, 0x83 });
+  Emit32(off);
+  Emit({ imm });
+}
+
+/* @Function Jit::EmitTick
+ * @brief Inline Cpu::Tick. */
+void Jit::EmitTick(u8 cycles) {
+  // add qword [r12+now], cycles
+  Emit({ 0x49, 0x83, 0x84, 0x24 });
+  Emit32(nowOff);
+  Emit({ cycles });
+
+  // mov rax, [r12+now]; cmp rax, [r12+next]
+  Emit({ 0x49, 0x8B, 0x84, 0x24 });
+  Emit32(nowOff);
+  Emit({ 0x49, 0x3B, 0x84, 0x24 });
+  Emit32(nextOff);
+
+  // jb over the call
+  Emit({ 0x72, 18 });
+  Emit({ 0x4C, 0x89, 0xE7 });  // mov rdi, r12
+  EmitCall((void *) &Jit::SchedRun);
+  Emit({ 0x41, 0xB5, 0x01 });  // mov r13b, 1
+}
+
+/* @Function Jit::EmitAlu
+ * @brief A <op> reg or imm with lazy flags, as Cpu::ALU records it. */
+void Jit::EmitAlu(u8 type, const u8 * reg, const u8 * imm) {
+  EmitLoad(X_AL, regOff[7]);
+  EmitStore(lazyXOff, X_AL);
+
+  if (reg) {
+    EmitLoad(X_CL, regOff[*reg]);
+  } else {
+    Emit({ 0xB1, *imm });      // mov cl, imm
+  }
+  EmitStore(lazyYOff, X_CL);
+
+  switch (type) {
+    case ALU_ADD_A: Emit({ 0x00, 0xC8 }); break; // add al, cl
+    case ALU_SUB:
+    case ALU_CP:    Emit({ 0x28, 0xC8 }); break; // sub al, cl
+    case ALU_AND:   Emit({ 0x20, 0xC8 }); break; // and al, cl
+    case ALU_XOR:   Emit({ 0x30, 0xC8 }); break; // xor al, cl
+    case ALU_OR:    Emit({ 0x08, 0xC8 }); break; // or al, cl
+  }
+
+  EmitStore(lazyResOff, X_AL);
+  if (type != ALU_CP) EmitStore(regOff[7], X_AL);
+  EmitStoreImm(lazyOpOff, LAZY_ADD + type);
+  EmitStoreImm(lazyCinOff, 0);
+}
+
+/* @Function Jit::EmitCheck
+ * @brief Leave the block if Exit() says so. Native instructions only
+ *    need the check if the scheduler ran during them. */
+void Jit::EmitCheck(bool always) {
+  if (!always) {
+    Emit({ 0x45, 0x84, 0xED });  // test r13b, r13b
+    Emit({ 0x74, 26 });          // jz over the check
+  }
+
+  Emit({ 0x45, 0x31, 0xED });    // xor r13d, r13d
+  Emit({ 0x48, 0x89, 0xDF });    // mov rdi, rbx
+  EmitCall((void *) &Jit::Exit);
+  Emit({ 0x84, 0xC0 });          // test al, al
+  Emit({ 0x0F, 0x85 });          // jnz epilogue
+  exits.push_back(buf.size());
+  Emit32(0);
+}
+
+/* @Function Jit::EmitNative
+ * @brief Emit an instruction inline if it only touches registers.
+ *    Returns false if it has to go through the interpreter. */
+bool Jit::EmitNative(const BlockOp & o) {
+  u8 op = o.op;
+  u8 y = (op >> 3) & 7;
+  u8 z = op & 7;
+
+  // NOP
+  if (op == 0x00) {
+    EmitTick(MEM_RW_CYCLES);
+    EmitAddWord(pcOff, 1);
+    return true;
+  }
+
+  // LD r, r
+  if (op >= 0x40 && op < 0x80 && y != 6 && z != 6) {
+    EmitTick(MEM_RW_CYCLES);
+    EmitLoad(X_AL, regOff[z]);
+    EmitStore(regOff[y], X_AL);
+    EmitAddWord(pcOff, 1);
+    return true;
+  }
+
+  // LD r, d8
+  if ((op & 0xC7) == 0x06 && y != 6) {
+    EmitTick(MEM_RW_CYCLES);
+    EmitTick(MEM_RW_CYCLES);
+    EmitStoreImm(regOff[y], o.imm[0]);
+    EmitAddWord(pcOff, 2);
+    return true;
+  }
+
+  // INC rp / DEC rp
+  if ((op & 0xC7) == 0x03) {
+    EmitTick(MEM_RW_CYCLES);
+    EmitTick(ALU_CYCLES);
+    EmitAddWord(rpOff[op >> 4], (op & 0x08) ? 0xFF : 0x01);
+    EmitAddWord(pcOff, 1);
+    return true;
+  }
+
+  // ADC and SBC need the carry, and eager flags are left to the
+  // interpreter
+  if (!cpu->lazyFlags || y == ALU_ADC_A || y == ALU_SBC_A) return false;
+
+  // ALU A, r
+  if (op >= 0x80 && op < 0xC0 && z != 6) {
+    EmitTick(MEM_RW_CYCLES);
+    EmitAlu(y, &z, NULL);
+    EmitAddWord(pcOff, 1);
+    return true;
+  }
+
+  // ALU A, d8
+  if ((op & 0xC7) == 0xC6) {
+    EmitTick(MEM_RW_CYCLES);
+    EmitTick(MEM_RW_CYCLES);
+    EmitAlu(y, NULL, &o.imm[0]);
+    EmitAddWord(pcOff, 2);
+    return true;
+  }
+
+  return false;
+}
+
+/* @Function Jit::Compile
+ * @brief Translate a block and attach the code to it. Returns false
+ *    if the block stays interpreted. */
+bool Jit::Compile(Block * block) {
+  if (full) return false;
+
+  buf.clear();
+  exits.clear();
+
+  // push rbx; push r12; push r13; mov rbx, rdi; mov r12, rsi;
+  // xor r13d, r13d
+  Emit({ 0x53, 0x41, 0x54, 0x41, 0x55 });
+  Emit({ 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4 });
+  Emit({ 0x45, 0x31, 0xED });
+
+  size_t n = block->ops.size();
+  for (size_t i = 0; i < n; i++) {
+    const BlockOp & o = block->ops[i];
+    bool native = EmitNative(o);
+
+    if (!native) {
+      Emit({ 0x48, 0x89, 0xDF });  // mov rdi, rbx
+      Emit({ 0x48, 0xBE });        // mov rsi, &o
+      Emit64((u64) &o);
+      EmitCall((void *) &Jit::Op);
+    }
+
+    // inc qword [rbx+retired]
+    Emit({ 0x48, 0xFF, 0x83 });
+    Emit32(retiredOff);
+
+    if (i + 1 < n) EmitCheck(!native);
+  }
+
+  // pop r13; pop r12; pop rbx; ret
+  size_t epilogue = buf.size();
+  Emit({ 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });
+
+  for (size_t at : exits) {
+    u32 rel = epilogue - (at + 4);
+    memcpy(&buf[at], &rel, 4);
+  }
+
+  if (codeUsed + buf.size() > JIT_CODE_SIZE) {
+    full = true;
+    return false;
+  }
+
+  u8 * fn = code + codeUsed;
+  memcpy(fn, buf.data(), buf.size());
+  codeUsed += (buf.size() + 15) & ~(size_t) 15;
+
+  block->native = (BlockFn) fn;
+  compiled++;
+  return true;
+}
+
+/* @Function Jit::State
+ * @brief Snapshot of the registers the differential test compares. */
+Jit_State Jit::State(Cpu * cpu) {
+  Jit_State s;
+  s.pc = cpu->pc;
+  s.sp = cpu->sp;
+  s.a = cpu->a;
+  s.f = cpu->GetFlagsAsInt();
+  s.bc = cpu->BC.w;
+  s.de = cpu->DE.w;
+  s.hl = cpu->HL.w;
+  s.ime = cpu->ime;
+  s.cpuState = cpu->cpuState;
+  s.now = cpu->sched->now;
+  s.retired = cpu->retired;
+  return s;
+}
+
+/* █▀▄ █ █▀▀ █▀▀ */
+/* █▄▀ █ █▀░ █▀░ */
+
+// One complete machine for the differential test
+class Jit_Machine
+{
+  public:
+    Scheduler sched;
+    Display disp;
+    Bus bus;
+    Ppu ppu;
+    Cpu cpu;
+    Debugger debugger;
+
+    Jit_Machine() : ppu(&bus, &disp), cpu(&bus, &ppu, NULL),
+                    debugger(&cpu, &bus, &ppu) {
+      cpu.debugger = &debugger;
+      cpu.sched = &sched;
+      ppu.sched = &sched;
+      bus.cpu = &cpu;
+      disp.cpu = &cpu;
+    }
+};
+
+static bool Jit_StateEqual(const Jit_State & x, const Jit_State & y) {
+  return x.pc == y.pc && x.sp == y.sp && x.a == y.a && x.f == y.f
+      && x.bc == y.bc && x.de == y.de && x.hl == y.hl
+      && x.ime == y.ime && x.cpuState == y.cpuState && x.now == y.now
+      && x.retired == y.retired;
+}
+
+static void Jit_PrintState(const char * name, const Jit_State & s) {
+  printf("%s PC %04X SP %04X A %02X F %02X BC %04X DE %04X HL %04X "
+         "IME %d state %d cycle %llu retired %llu\n", name, s.pc, s.sp,
+         s.a, s.f, s.bc, s.de, s.hl, s.ime, s.cpuState,
+         (unsigned long long) s.now, (unsigned long long) s.retired);
+}
+
+/* @Function Jit_Diff
+ * @brief Run the ROM on two machines in lockstep, one with the JIT and
+ *    one interpreting, and compare registers after every block. Both
+ *    end blocks at the same places, so any difference is a
+ *    translation bug. Returns EXIT_FAILURE at the first mismatch. */
+int Jit_Diff(std::string romFname, u32 blocks) {
+  Jit_Machine * jit = new Jit_Machine;
+  Jit_Machine * ref = new Jit_Machine;
+
+  // Each machine gets its own blank cart RAM. Sharing the mapped .sav
+  // would let one machine's writes show up in the other's.
+  if (jit->bus.CopyRom(romFname, false) == FAILURE ||
+      ref->bus.CopyRom(romFname, false) == FAILURE) {
+    printf("ROM could not be loaded\n");
+    delete jit;
+    delete ref;
+    return EXIT_FAILURE;
+  }
+
+  for (Jit_Machine * m : { jit, ref }) {
+    m->bus.Init();
+    m->cpu.Init();
+    m->ppu.Init();
+  }
+  jit->cpu.jit = new Jit(&jit->cpu);
+
+  std::string jitSerial, refSerial;
+  jit->cpu.serial.AddSink(Serial_BufferSink, &jitSerial);
+  ref->cpu.serial.AddSink(Serial_BufferSink, &refSerial);
+
+  printf("=== AMPHY JIT DIFF: %u blocks ===\n", blocks);
+
+  int status = EXIT_SUCCESS;
+  for (u32 i = 0; i < blocks; i++) {
+    Jit_State before = Jit::State(&ref->cpu);
+
+    jit->cpu.Execute();
+    ref->cpu.Execute();
+
+    Jit_State x = Jit::State(&jit->cpu);
+    Jit_State y = Jit::State(&ref->cpu);
+    if (!Jit_StateEqual(x, y)) {
+      printf("Mismatch after block %u at %04X\n", i, before.pc);
+      Jit_PrintState("Before:", before);
+      Jit_PrintState("JIT:   ", x);
+      Jit_PrintState("Interp:", y);
+      status = EXIT_FAILURE;
+      break;
+    }
+  }
+
+  if (status == EXIT_SUCCESS && jitSerial != refSerial) {
+    printf("Serial output differs\n");
+    status = EXIT_FAILURE;
+  }
+
+  if (status == EXIT_SUCCESS) printf("No mismatches\n");
+  printf("Blocks compiled:      %u\n", jit->cpu.jit->compiled);
+  printf("Compiled block runs:  %llu\n",
+         (unsigned long long) jit->cpu.jit->runs);
+
+  delete jit->cpu.jit;
+  delete jit;
+  delete ref;
+  return status;
+}
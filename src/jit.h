@@ -0,0 +1,91 @@
+
+/* ░░█ █ ▀█▀ */
+/* █▄█ █ ░█░ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <string>
+#include <vector>
+#include "common.h"
+#include "block.h"
+
+// Runs before a ROM block is compiled
+#define JIT_THRESHOLD 64
+
+// Executable memory for compiled blocks. Once it is full, new blocks
+// stay interpreted.
+#define JIT_CODE_SIZE (16 << 20)
+
+class Cpu;
+class Scheduler;
+
+// Cpu state compared by the differential test
+typedef struct Jit_State {
+  u16 pc, sp;
+  u8 a, f;
+  u16 bc, de, hl;
+  bool ime;
+  u8 cpuState;
+  u64 now;
+  u64 retired;
+} Jit_State;
+
+/* Translates hot ROM blocks into x86-64. Register moves, 8-bit
+ * immediates, 16-bit INC/DEC and the flag-recording ALU ops are
+ * emitted inline against the Cpu's own fields. Everything else,
+ * including any instruction that touches memory, calls the
+ * interpreter's handler, so cycle-exact sections keep their exact
+ * per-access timing. RAM blocks are never compiled, which leaves
+ * self-modifying code to the interpreter. */
+class Jit
+{
+  private:
+    u8 * code = NULL;   // executable region
+    size_t codeUsed = 0;
+    bool full = false;
+
+    Cpu * cpu;
+
+    // Offsets of the Cpu and Scheduler fields the generated code uses,
+    // taken from live objects
+    u32 regOff[8];   // B C D E H L - A
+    u32 rpOff[4];    // BC DE HL SP
+    u32 pcOff, retiredOff;
+    u32 lazyOpOff, lazyXOff, lazyYOff, lazyResOff, lazyCinOff;
+    u32 nowOff, nextOff;
+
+    std::vector<u8> buf;
+    std::vector<size_t> exits; // rel32 jumps to the epilogue
+
+    void Emit(std::initializer_list<u8> bytes);
+    void Emit32(u32 val);
+    void Emit64(u64 val);
+    void EmitCall(void * fn);
+    void EmitLoad(u8 reg, u32 off);
+    void EmitStore(u32 off, u8 reg);
+    void EmitStoreImm(u32 off, u8 imm);
+    void EmitAddWord(u32 off, u8 imm);
+    void EmitTick(u8 cycles);
+    void EmitAlu(u8 type, const u8 * reg, const u8 * imm);
+    void EmitCheck(bool always);
+    bool EmitNative(const BlockOp & o);
+
+    static void SchedRun(Scheduler * sched);
+    static void Op(Cpu * cpu, const BlockOp * o);
+    static bool Exit(Cpu * cpu);
+
+  public:
+    u32 compiled = 0;  // blocks translated
+    u64 runs = 0;      // compiled block executions
+
+    Jit(Cpu * cpu_);
+    ~Jit();
+
+    bool Compile(Block * block);
+    static Jit_State State(Cpu * cpu);
+};
+
+int Jit_Diff(std::string romFname, u32 blocks);
+
+#endif
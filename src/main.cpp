@@ -6,8 +6,12 @@
 #include "cpu.h"
 #include "bus.h"
 #include "ppu.h"
+#include "scheduler.h"
 #include "utils.h"
 #include "debug.h"
+#include "bench.h"
+#include "jit.h"
+#include "pacer.h"
 
 int main( int argc, char* argv[] )
 {
@@ -17,7 +21,9 @@ int main( int argc, char* argv[] )
   Ppu* ppu;
   Display* disp;
   Debugger* debugger;
+  Scheduler* sched;
 
+  sched = new Scheduler;
   disp = new Display;
   bus = new Bus;
   ppu = new Ppu(bus, disp);
@@ -28,11 +34,21 @@ int main( int argc, char* argv[] )
   cpu->debugger = debugger;
   cpu->ppu = ppu;
   cpu->bus = bus;
+  cpu->sched = sched;
+  ppu->sched = sched;
   bus->cpu = cpu;
   disp->cpu = cpu;
 
   ParseFlags(argc, argv, cpu);
 
+  if (cpu->bench && argc > 1) {
+    return Bench_Run(argv[argc-1], cpu->bench);
+  }
+
+  if (cpu->jitDiff && argc > 1) {
+    return Jit_Diff(argv[argc-1], cpu->jitDiff);
+  }
+
   // Read ROM (default to test rom if nothing was given)
   bool bus_status;
   if (argc > 1) {
@@ -52,10 +68,43 @@ int main( int argc, char* argv[] )
   ppu->Init();
   disp->Init();
 
+  if (cpu->useJit) cpu->jit = new Jit(cpu);
+
+  // Serial output, e.g. from Blargg's test ROMs
+  FILE * serialOut = NULL;
+  if (cpu->serialPath) {
+    serialOut = fopen(cpu->serialPath, "wb");
+    if (serialOut == NULL) {
+      printf("Could not open %s for serial output\n", cpu->serialPath);
+      return EXIT_FAILURE;
+    }
+    cpu->serial.AddSink(Serial_FileSink, serialOut);
+  } else {
+    cpu->serial.AddSink(Serial_StderrSink, NULL);
+  }
+
+  Pacer pacer;
+  u64 frame = disp->frames;
+  if (cpu->turbo > 0) pacer.Start(cpu->turbo);
+
   while(!disp->amphy_quit) {
+    if (cpu->frameLimit && disp->frames >= cpu->frameLimit) break;
+
+    // Hold each finished frame until it is due
+    if (disp->frames != frame) {
+      frame = disp->frames;
+      if (cpu->turbo > 0) pacer.Frame();
+    }
 
     // disp->HandleEvent();
 
+    // Time stands still in STOP and only a button press ends it, so
+    // sleep until there is input instead of spinning
+    if (cpu->Stopped()) {
+      disp->WaitEvent(IDLE_WAIT_MS);
+      continue;
+    }
+
     try {
       cpu->Execute();
     } catch (...) {
@@ -63,18 +112,18 @@ int main( int argc, char* argv[] )
       debugger->Regdump();
       return EXIT_FAILURE;
     }
-
-    // Read serial output from Blargg's test roms
-    if (bus->Read(0xFF02) == 0x81) {
-      fprintf(stderr, "%c", bus->Read(0xFF01));
-      bus->Write(0xFF02, 0);
-    }
   }
 
+  if (cpu->idleReport) cpu->IdleLoop_Report();
+  if (cpu->paceReport) pacer.Report();
+  if (serialOut) fclose(serialOut);
+
   // Free resources and close SDL
+  delete(cpu->jit);
   delete(cpu);
   delete(bus);
   delete(ppu);
+  delete(sched);
 
   disp->Close();
 
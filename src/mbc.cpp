@@ -0,0 +1,250 @@
+
+/* █▀▄▀█ █▄▄ █▀▀ */
+/* █░▀░█ █▄█ █▄▄ */
+
+#include <stdio.h>
+#include "common.h"
+#include "mbc.h"
+#include "bus.h"
+
+/* @Function CreateMbc
+ * @brief Pick the controller for the cart type in the header. */
+Mbc * CreateMbc(Bus * bus, u8 cartType) {
+  switch (cartType) {
+    case CT_MBC1:
+    case CT_MBC1_RAM:
+    case CT_MBC1_RAM_BAT:
+      return new Mbc1(bus);
+
+    case CT_MBC2:
+    case CT_MBC2_BAT:
+      return new Mbc2(bus);
+
+    case CT_MBC3_TMR_BAT:
+    case CT_MBC3_TMR_RAM_BAT_2:
+    case CT_MBC3:
+    case CT_MBC3_RAM_2:
+    case CT_MBC3_RAM_BAT_2:
+      return new Mbc3(bus);
+
+    case CT_MBC5:
+    case CT_MBC5_RAM:
+    case CT_MBC5_RAM_BAT:
+      return new Mbc5(bus, false);
+
+    case CT_MBC5_RUM:
+    case CT_MBC5_RUM_RAM:
+    case CT_MBC5_RUM_RAM_BAT:
+      return new Mbc5(bus, true);
+
+    case CT_ROM_ONLY:
+    case CT_ROM_RAM_1:
+    case CT_ROM_RAM_BAT_1:
+      return new Mbc_None(bus);
+
+    default:
+      fprintf(stderr, "Unsupported cart type %02X, treating as ROM only\n", cartType);
+      return new Mbc_None(bus);
+  }
+}
+
+/* █▀▄▀█ █▄▄ █▀▀ ▄█ */
+/* █░▀░█ █▄█ █▄▄ ░█ */
+
+void Mbc1::Write(u16 addr, u8 v) {
+  // RAM enable
+  if (addr < MBC_RAM_EN_END) {
+    ramEnable = (v & 0xF) == MBC_RAM_EN_VAL;
+  }
+
+  // ROM bank number. Only lower 5 bits used, 0 maps to 1
+  else if (addr < MBC_ROM_BANK_END) {
+    bank1 = v & 0x1F;
+    if (bank1 == 0) bank1 = 1;
+  }
+
+  // RAM bank number or upper bits of ROM bank number
+  else if (addr < MBC_RAM_BANK_END) {
+    bank2 = v & 0b11;
+  }
+
+  // Banking mode select
+  else {
+    mode = (v & 0x1) ? RAM_MODE : ROM_MODE;
+  }
+
+  Remap();
+}
+
+/* @Function Mbc1::Remap
+ * @brief In RAM mode, bank2 also selects the bank at 0000-3FFF and
+ *    the RAM bank. In ROM mode, both of those are fixed at 0. */
+void Mbc1::Remap() {
+  bus->SwitchBanks((bank2 << 5) | bank1);
+
+  if (mode == RAM_MODE) {
+    bus->SwitchBank0(bank2 << 5);
+  } else {
+    bus->SwitchBank0(0);
+  }
+
+  if (ramEnable) {
+    bus->SwitchRamBank(mode == RAM_MODE ? bank2 : 0);
+  } else {
+    bus->DisableRam();
+  }
+}
+
+/* █▀▄▀█ █▄▄ █▀▀ ▀█ */
+/* █░▀░█ █▄█ █▄▄ █▄ */
+
+/* If bit 8 of the address is set: ROM bank number; else RAM enable.
+ * Built-in 512x4 bit RAM is always accessed through ReadRam/WriteRam. */
+void Mbc2::Write(u16 addr, u8 v) {
+  if (addr >= MBC_ROM_BANK_END) return;
+
+  if (BIT_TEST(addr, 8)) {
+    u8 bank = v & 0xF; // lower 4 bits specify bank
+    if (bank == 0) bank++;
+    bus->SwitchBanks(bank);
+  } else {
+    ramEnable = (v & 0xF) == MBC_RAM_EN_VAL;
+    if (!ramEnable) bus->DisableRam();
+  }
+}
+
+/* Only the lower 9 bits of the address are used, so A000-A1FF is
+ * echoed across A000-BFFF. Upper nibble reads back as 1s. */
+u8 Mbc2::ReadRam(u16 addr) {
+  if (!ramEnable) return 0xFF;
+  return bus->GetExtRam()[addr & (MBC2_RAM_SIZE - 1)] | 0xF0;
+}
+
+void Mbc2::WriteRam(u16 addr, u8 val) {
+  if (!ramEnable) return;
+  bus->GetExtRam()[addr & (MBC2_RAM_SIZE - 1)] = val & 0x0F;
+  bus->Save_MarkDirty(addr & (MBC2_RAM_SIZE - 1));
+}
+
+/* █▀▄▀█ █▄▄ █▀▀ ▀▀█ */
+/* █░▀░█ █▄█ █▄▄ ▄██ */
+
+void Mbc3::Write(u16 addr, u8 v) {
+  // RAM and RTC enable
+  if (addr < MBC_RAM_EN_END) {
+    ramEnable = (v & 0xF) == MBC_RAM_EN_VAL;
+    Remap();
+  }
+
+  // ROM bank number. 7 bits, 0 maps to 1
+  else if (addr < MBC_ROM_BANK_END) {
+    v &= 0x7F;
+    if (v == 0) v = 1;
+    bus->SwitchBanks(v);
+  }
+
+  // RAM bank number or RTC register select
+  else if (addr < MBC_RAM_BANK_END) {
+    ramBank = v & 0x0F;
+    Remap();
+  }
+
+  // Writing 00 then 01 latches the clock
+  else {
+    if (latchReg == 0x00 && v == 0x01) RTC_Latch();
+    latchReg = v;
+  }
+}
+
+/* @Function Mbc3::Remap
+ * @brief RAM banks are mapped directly. RTC registers have no
+ *    backing memory, so A000-BFFF is left to ReadRam/WriteRam. */
+void Mbc3::Remap() {
+  if (ramEnable && ramBank < RTC_S) {
+    bus->SwitchRamBank(ramBank);
+  } else {
+    bus->DisableRam();
+  }
+}
+
+u8 Mbc3::ReadRam(u16) {
+  if (!ramEnable || ramBank < RTC_S || ramBank > RTC_DH) return 0xFF;
+  return rtcLatched[ramBank - RTC_S];
+}
+
+void Mbc3::WriteRam(u16, u8 val) {
+  if (!ramEnable || ramBank < RTC_S || ramBank > RTC_DH) return;
+  RTC_Set(ramBank, val);
+}
+
+/* @Function Mbc3::RTC_Latch
+ * @brief Fold the host time elapsed since rtcBase into the RTC
+ *    registers and copy them to the latched registers. */
+void Mbc3::RTC_Latch() {
+  time_t now = time(NULL);
+
+  if (!BIT_TEST(rtc[RTC_DH - RTC_S], RTC_DH_HALT)) {
+    long elapsed = now - rtcBase;
+    u16 days = ((rtc[RTC_DH - RTC_S] & 0x1) << 8) | rtc[RTC_DL - RTC_S];
+
+    long secs = rtc[RTC_S - RTC_S] + elapsed;
+    long mins = rtc[RTC_M - RTC_S] + secs / 60;
+    long hours = rtc[RTC_H - RTC_S] + mins / 60;
+    long totalDays = days + hours / 24;
+
+    rtc[RTC_S - RTC_S] = secs % 60;
+    rtc[RTC_M - RTC_S] = mins % 60;
+    rtc[RTC_H - RTC_S] = hours % 24;
+    rtc[RTC_DL - RTC_S] = totalDays & 0xFF;
+
+    u8 dh = rtc[RTC_DH - RTC_S] & 0xFE;
+    dh |= (totalDays >> 8) & 0x1;
+    if (totalDays > 0x1FF) dh = BIT_SET(dh, RTC_DH_CARRY);
+    rtc[RTC_DH - RTC_S] = dh;
+  }
+
+  rtcBase = now;
+  for (u8 i = 0; i < RTC_REGS; i++) rtcLatched[i] = rtc[i];
+}
+
+void Mbc3::RTC_Set(u8 reg, u8 val) {
+  // Bring the running registers up to date before changing one
+  RTC_Latch();
+  rtc[reg - RTC_S] = val;
+  rtcLatched[reg - RTC_S] = val;
+}
+
+/* █▀▄▀█ █▄▄ █▀▀ █▀ */
+/* █░▀░█ █▄█ █▄▄ ▄█ */
+
+void Mbc5::Write(u16 addr, u8 v) {
+  // RAM enable
+  if (addr < MBC_RAM_EN_END) {
+    ramEnable = v == MBC_RAM_EN_VAL;
+    Remap();
+  }
+
+  // ROM bank number. 2000-2FFF: lower 8 bits, 3000-3FFF: bit 9.
+  // Unlike the others, bank 0 can be mapped to 4000-7FFF.
+  else if (addr < 0x3000) {
+    romBank = (romBank & 0x100) | v;
+    bus->SwitchBanks(romBank);
+  } else if (addr < MBC_ROM_BANK_END) {
+    romBank = ((v & 0x1) << 8) | (romBank & 0xFF);
+    bus->SwitchBanks(romBank);
+  }
+
+  // RAM bank number
+  else if (addr < MBC_RAM_BANK_END) {
+    ramBank = v & (rumble ? 0x07 : 0x0F);
+    Remap();
+  }
+}
+
+void Mbc5::Remap() {
+  if (ramEnable) {
+    bus->SwitchRamBank(ramBank);
+  } else {
+    bus->DisableRam();
+  }
+}
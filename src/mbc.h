@@ -0,0 +1,144 @@
+
+/* █▀▄▀█ █▄▄ █▀▀ */
+/* █░▀░█ █▄█ █▄▄ */
+
+#ifndef MBC_H
+#define MBC_H
+
+#include <time.h>
+#include "common.h"
+
+// Register addresses (upper bound of each write range)
+#define MBC_RAM_EN_END    0x2000
+#define MBC_ROM_BANK_END  0x4000
+#define MBC_RAM_BANK_END  0x6000
+
+#define MBC_RAM_EN_VAL    0x0A
+
+#define MBC2_RAM_SIZE     512
+
+// MBC3 RTC registers, selected by writing 08-0C to 4000-5FFF
+#define RTC_S   0x08
+#define RTC_M   0x09
+#define RTC_H   0x0A
+#define RTC_DL  0x0B
+#define RTC_DH  0x0C
+#define RTC_REGS 5
+#define RTC_DH_HALT  6
+#define RTC_DH_CARRY 7
+
+enum mbcModeSelect {
+  ROM_MODE,
+  RAM_MODE
+};
+
+class Bus;
+
+/* Memory bank controllers. Register writes to 0000-7FFF land here,
+ * and each controller remaps ROM/RAM banks by repointing Bus page
+ * table entries, so banked accesses cost the same as unbanked ones.
+ * ReadRam/WriteRam are only reached while A000-BFFF is unmapped
+ * (RAM disabled, MBC2 nibble RAM, MBC3 RTC registers). */
+class Mbc
+{
+  protected:
+    Bus * bus;
+    bool ramEnable = false;
+
+  public:
+    virtual void Write(u16 addr, u8 val) = 0;
+    virtual u8 ReadRam(u16) { return 0xFF; }
+    virtual void WriteRam(u16, u8) {}
+
+    bool RamEnabled() { return ramEnable; }
+
+    Mbc(Bus * bus_) {
+      bus = bus_;
+    }
+    virtual ~Mbc() {}
+};
+
+/* No MBC: cartridge RAM, if any, is always mapped */
+class Mbc_None : public Mbc
+{
+  public:
+    void Write(u16, u8) {}
+
+    Mbc_None(Bus * bus_) : Mbc(bus_) {
+      ramEnable = true;
+    }
+};
+
+class Mbc1 : public Mbc
+{
+  private:
+    u8 bank1 = 1; // 5-bit ROM bank register
+    u8 bank2 = 0; // 2-bit RAM bank/upper ROM bank register
+    u8 mode = ROM_MODE;
+
+    void Remap();
+
+  public:
+    void Write(u16 addr, u8 val);
+
+    Mbc1(Bus * bus_) : Mbc(bus_) {}
+};
+
+/* 512x4 bit RAM lives in the bus's ext_ram, so it gets battery
+ * saves like any other cart RAM */
+class Mbc2 : public Mbc
+{
+  public:
+    void Write(u16 addr, u8 val);
+    u8 ReadRam(u16 addr);
+    void WriteRam(u16 addr, u8 val);
+
+    Mbc2(Bus * bus_) : Mbc(bus_) {}
+};
+
+class Mbc3 : public Mbc
+{
+  private:
+    u8 ramBank = 0; // 00-07 RAM bank, 08-0C RTC register
+    u8 latchReg = 0xFF;
+
+    // RTC counts from rtcBase (host time) unless halted.
+    // Latched values are what the game reads.
+    time_t rtcBase = 0;
+    u8 rtc[RTC_REGS] = {};
+    u8 rtcLatched[RTC_REGS] = {};
+
+    void Remap();
+    void RTC_Latch();
+    void RTC_Set(u8 reg, u8 val);
+
+  public:
+    void Write(u16 addr, u8 val);
+    u8 ReadRam(u16 addr);
+    void WriteRam(u16 addr, u8 val);
+
+    Mbc3(Bus * bus_) : Mbc(bus_) {
+      rtcBase = time(NULL);
+    }
+};
+
+class Mbc5 : public Mbc
+{
+  private:
+    u16 romBank = 1; // 9 bits
+    u8 ramBank = 0;
+    bool rumble = false; // bit 3 of the RAM bank drives the motor
+
+    void Remap();
+
+  public:
+    void Write(u16 addr, u8 val);
+
+    Mbc5(Bus * bus_, bool rumble_) : Mbc(bus_) {
+      rumble = rumble_;
+    }
+};
+
+Mbc * CreateMbc(Bus * bus, u8 cartType);
+
+#endif
@@ -0,0 +1,81 @@
+
+/* █▀█ ▄▀█ █▀▀ █▀▀ █▀█ */
+/* █▀▀ █▀█ █▄▄ ██▄ █▀▄ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include "pacer.h"
+
+/* @Function Pacer::Now
+ * @brief Monotonic time in nanoseconds. */
+u64 Pacer::Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* @Function Pacer::Start
+ * @brief Begin pacing at turbo times the Game Boy's frame rate. The
+ *    first frame is due one period from now. */
+void Pacer::Start(double turbo) {
+  period = PACER_FRAME_NS / turbo;
+  last = Now();
+  deadline = last;
+}
+
+/* @Function Pacer::Frame
+ * @brief Called once per emulated frame. Sleeps until shortly before
+ *    the frame is due, then spins until it is. */
+void Pacer::Frame() {
+  deadline += period;
+  u64 now = Now();
+
+  if (now > deadline + period) {
+    deadline = now;
+    resyncs++;
+  } else {
+    if (now + PACER_SPIN_NS < deadline) {
+      u64 wake = deadline - PACER_SPIN_NS;
+      struct timespec ts;
+      ts.tv_sec = wake / 1000000000;
+      ts.tv_nsec = wake % 1000000000;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+    }
+    do {
+      now = Now();
+    } while (now < deadline);
+  }
+
+  u64 interval = now - last;
+  intervals++;
+  intervalSum += interval;
+  intervalSumSq += (double) interval * interval;
+  if (interval < intervalMin) intervalMin = interval;
+  if (interval > intervalMax) intervalMax = interval;
+  if (now - deadline > lateMax) lateMax = now - deadline;
+  last = now;
+}
+
+/* @Function Pacer::Report
+ * @brief Print frame time statistics. Jitter is the standard
+ *    deviation of the frame-to-frame interval. */
+void Pacer::Report() {
+  printf("=== FRAME PACING ===\n");
+  if (intervals == 0) {
+    printf("No frames paced\n");
+    return;
+  }
+
+  double mean = intervalSum / intervals;
+  double var = intervalSumSq / intervals - mean * mean;
+  double jitter = var > 0 ? sqrt(var) : 0;
+
+  printf("Frames: %llu, target %.3f ms (%.4f Hz)\n",
+      (unsigned long long) intervals, period / 1e6, 1e9 / period);
+  printf("Interval: mean %.3f ms, min %.3f ms, max %.3f ms\n",
+      mean / 1e6, intervalMin / 1e6, intervalMax / 1e6);
+  printf("Jitter: %.1f us, worst lateness %.1f us, %u resyncs\n",
+      jitter / 1e3, lateMax / 1e3, resyncs);
+}
@@ -0,0 +1,54 @@
+
+/* █▀█ ▄▀█ █▀▀ █▀▀ █▀█ */
+/* █▀▀ █▀█ █▄▄ ██▄ █▀▄ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include "common.h"
+
+// One frame is 70224 t-cycles at 4194304 Hz, or 59.7275 Hz
+#define PACER_FRAME_NS (70224 * 1000000000.0 / 4194304)
+
+// The last stretch before a deadline is busy-waited, since sleeps
+// can overshoot by scheduler latency
+#define PACER_SPIN_NS 1000000
+
+// Headless runs are batch jobs and go flat out unless asked
+#ifdef PLATFORM_HEADLESS
+  #define PACER_TURBO 0
+#else
+  #define PACER_TURBO 1
+#endif
+
+/* Holds the emulator to the Game Boy's frame rate, times turbo.
+ * Deadlines are absolute, so a late frame is made up by the next
+ * ones instead of drifting. After falling more than a frame behind
+ * (a debugger stop, a stalled host) the schedule restarts from now
+ * rather than racing to catch up. */
+class Pacer
+{
+  private:
+    u64 period = 0;   // ns per frame
+    u64 deadline = 0; // when the next frame is due, CLOCK_MONOTONIC
+    u64 last = 0;     // when the previous frame was let through
+
+    // Frame-to-frame intervals, and how late each frame was let
+    // through past its deadline
+    u64 intervals = 0;
+    double intervalSum = 0;
+    double intervalSumSq = 0;
+    u64 intervalMin = UINT64_MAX;
+    u64 intervalMax = 0;
+    u64 lateMax = 0;
+    u32 resyncs = 0;
+
+    static u64 Now();
+
+  public:
+    void Start(double turbo);
+    void Frame();
+    void Report();
+};
+
+#endif
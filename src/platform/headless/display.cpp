@@ -0,0 +1,33 @@
+
+#include "../platform.h"
+
+/* @Function Display::DrawPixel()
+ * @brief Writes a pixel to the framebuffer. The per-dot renderer runs
+ *    x past the right edge, so those are dropped here. */
+void Display::DrawPixel(u16 x, u16 y, Color * c) {
+  if (x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) return;
+  framebuffer[y * SCREEN_WIDTH + x] = 0xFF000000 | (c->r << 16) | (c->g << 8) | c->b;
+}
+
+/* @Function Display::WaitEvent()
+ * @brief Only called in STOP. With no input, nothing can ever end
+ *    STOP, and no more frames will come, so quit. */
+void Display::WaitEvent(int) {
+  printf("CPU stopped with no input to wake it: exiting\n");
+  amphy_quit = true;
+}
+
+/* @Function Display::Render() */
+void Display::Render() {
+  cleared = false;
+  frames++;
+}
+
+/* @Function Display::Clear() */
+void Display::Clear(Color * c) {
+  cleared = true;
+  u32 argb = 0xFF000000 | (c->r << 16) | (c->g << 8) | c->b;
+  for (u32 i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    framebuffer[i] = argb;
+  }
+}
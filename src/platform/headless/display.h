@@ -0,0 +1,44 @@
+
+/* █░█ █▀▀ ▄▀█ █▀▄ █░░ █▀▀ █▀ █▀ */
+/* █▀█ ██▄ █▀█ █▄▀ █▄▄ ██▄ ▄█ ▄█ */
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../common.h"
+
+class Cpu;
+
+/* Same interface as the SDL display, without a window. Frames are
+ * drawn into the framebuffer and counted, and nothing else happens,
+ * so ROMs can run on machines with no video at all. There is no
+ * input and no quit event; the emulator runs until the frame limit
+ * (-f), until the ROM executes STOP, or until it is killed. */
+class Display
+{
+  public:
+    bool amphy_quit = false;
+
+    Cpu * cpu;
+
+    bool cleared = false;
+
+    // Frames rendered so far
+    u64 frames = 0;
+
+    u32 framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+  public:
+    bool Init() { return EXIT_SUCCESS; }
+    void Close() {}
+    void HandleEvent() {}
+    void WaitEvent(int ms);
+    void DrawPixel(u16 x, u16 y, Color * c);
+    u32 * Line(u16 y) { return framebuffer + y * SCREEN_WIDTH; }
+    void Render();
+    void Clear(Color * c);
+};
+
+#endif
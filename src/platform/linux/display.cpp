@@ -3,24 +3,23 @@
 #include <stdio.h>
 #include <fstream>
 
-#include "display.h"
+#include "../platform.h"
 #include "../../ppu.h"
 #include "../../common.h"
 
 /* @Function Display::init()
- * @brief Initialize SDL window. */
+ * @brief Initialize SDL window and start the present thread. */
 bool Display::Init() {
   bool status = EXIT_SUCCESS;
 
   if( SDL_Init( SDL_INIT_VIDEO ) >= 0 ) {
-    SDL_CreateWindowAndRenderer(SCREEN_WIDTH * 3,
-                                SCREEN_HEIGHT * 3,
-                                0,
-                                &gWindow, &renderer);
-    if (gWindow != NULL) {
-      gScreenSurface = SDL_GetWindowSurface( gWindow );
-      SDL_SetWindowTitle(gWindow, "Amphy");
-    } else {
+    gWindow = SDL_CreateWindow("Amphy",
+                               SDL_WINDOWPOS_UNDEFINED,
+                               SDL_WINDOWPOS_UNDEFINED,
+                               SCREEN_WIDTH * 3,
+                               SCREEN_HEIGHT * 3,
+                               0);
+    if (gWindow == NULL) {
       printf("Display could not be created! SDL_Error: %s", SDL_GetError());
       status = EXIT_FAILURE;
     }
@@ -29,10 +28,10 @@ bool Display::Init() {
     status = EXIT_FAILURE;
   }
 
-  SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
-
   if ( status == EXIT_SUCCESS ) {
     // LoadSplash();
+    presenting = true;
+    presenter = std::thread(&Display::Present_Loop, this);
   } else {
     printf("SDL: Failed to initialize.");
   }
@@ -40,6 +39,51 @@ bool Display::Init() {
   return status;
 }
 
+/* @Function Display::Present_Loop
+ * @brief Body of the present thread. It owns the renderer, so a
+ *    blocking SDL_RenderPresent (vsync, a slow compositor) only holds
+ *    up this thread. Frames finished while it is busy replace each
+ *    other in middle; only the newest is shown. */
+void Display::Present_Loop() {
+  renderer = SDL_CreateRenderer(gWindow, -1, 0);
+  if (renderer == NULL) {
+    printf("Renderer could not be created! SDL_Error: %s", SDL_GetError());
+    return;
+  }
+
+  SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+  texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                              SDL_TEXTUREACCESS_STREAMING,
+                              SCREEN_WIDTH, SCREEN_HEIGHT);
+  if (texture == NULL) {
+    printf("Texture could not be created! SDL_Error: %s", SDL_GetError());
+    SDL_DestroyRenderer(renderer);
+    renderer = NULL;
+    return;
+  }
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(presentMutex);
+      presentCv.wait(lock, [this] {
+        return !presenting || (middle & FRAME_FRESH);
+      });
+    }
+    if (!presenting) break;
+
+    front = middle.exchange(front) & FRAME_INDEX;
+    SDL_UpdateTexture(texture, NULL, buffers[front], SCREEN_WIDTH * sizeof(u32));
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+  }
+
+  SDL_DestroyTexture(texture);
+  texture = NULL;
+  SDL_DestroyRenderer(renderer);
+  renderer = NULL;
+}
+
 /* @Function Display::LoadSplash
  * @brief Show Cute splash screen */
 bool Display::LoadSplash()
@@ -62,6 +106,15 @@ bool Display::LoadSplash()
  * @brief Frees media and shuts down SDL. */
 void Display::Close()
 {
+  if (presenter.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(presentMutex);
+      presenting = false;
+    }
+    presentCv.notify_one();
+    presenter.join();
+  }
+
   SDL_FreeSurface( gSurface );
   gSurface = NULL;
 
@@ -85,15 +138,37 @@ void Display::ApplyImg() {
 }
 
 /* @Function Display::RenderPixel()
- * @brief Renders a pixel to the screen. */
+ * @brief Writes a pixel to the framebuffer. The per-dot renderer runs
+ *    x past the right edge, so those are dropped here. */
 void Display::DrawPixel(u16 x, u16 y, Color * c) {
-  SDL_SetRenderDrawColor(renderer, c->r, c->g, c->b, 0xFF);
-  SDL_RenderDrawPoint(renderer, x, y); 
+  if (x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT) return;
+  framebuffer[y * SCREEN_WIDTH + x] = 0xFF000000 | (c->r << 16) | (c->g << 8) | c->b;
 }
 
+/* @Function Display::Render()
+ * @brief Publishes the finished frame to the present thread and
+ *    starts the next one in a free buffer. The next frame starts as a
+ *    copy of this one, since lines the PPU skips keep their pixels. */
 void Display::Render() {
   cleared = false;
-  SDL_RenderPresent(renderer);
+  frames++;
+
+  u8 done = back;
+  back = middle.exchange(back | FRAME_FRESH) & FRAME_INDEX;
+  framebuffer = buffers[back];
+  memcpy(framebuffer, buffers[done], sizeof(buffers[done]));
+
+  // The present thread checks for a frame under the lock; taking it
+  // here makes sure it is either before the check or already waiting
+  { std::lock_guard<std::mutex> lock(presentMutex); }
+  presentCv.notify_one();
+}
+
+/* @Function Display::WaitEvent
+ * @brief Block until an event arrives or ms pass, then handle
+ *    everything queued. Used while the emulated machine is idle. */
+void Display::WaitEvent(int ms) {
+  if (SDL_WaitEventTimeout(NULL, ms)) HandleEvent();
 }
 
 /* @Function Display::HandleEvent */
@@ -178,6 +253,8 @@ void Display::HandleEvent() {
 
 void Display::Clear(Color * c) {
   cleared = true;
-  SDL_SetRenderDrawColor(renderer, c->r, c->g, c->b, 0xFF);
-  SDL_RenderClear(renderer);
+  u32 argb = 0xFF000000 | (c->r << 16) | (c->g << 8) | c->b;
+  for (u32 i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    framebuffer[i] = argb;
+  }
 }
@@ -7,8 +7,17 @@
 
 #include <SDL2/SDL.h>
 #include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "../../common.h"
 
+// middle holds a buffer index, plus this bit while the frame in it
+// hasn't been shown
+#define FRAME_INDEX 0b011
+#define FRAME_FRESH 0b100
+
 // Size of SDL screen
 #define GAMEBOY_WIDTH 160
 #define GAMEBODY_HEIGHT 144
@@ -17,8 +26,6 @@
 
 // #define SCREEN_WIDTH GAMEBOY_WIDTH * SCALE_FACTOR
 // #define SCREEN_HEIGHT GAMEBODY_HEIGHT * SCALE_FACTOR
-#define SCREEN_WIDTH 160
-#define SCREEN_HEIGHT 144
 
 enum KeyPressSurfaces {
   KEY_PRESS_SURFACE_DEFAULT,
@@ -43,7 +50,19 @@ class Display
     // The image we will load and show on the screen
     SDL_Surface* gSurface = NULL;
 
+    // Owned by the present thread
     SDL_Renderer* renderer = NULL;
+    SDL_Texture* texture = NULL;
+
+    // Triple buffer. The PPU draws into framebuffer, buffers[back].
+    // Render swaps it with middle, the latest finished frame, and the
+    // present thread swaps middle with front, the one it shows.
+    // Neither side ever waits for the other.
+    u32 buffers[3][SCREEN_WIDTH * SCREEN_HEIGHT];
+    u32 * framebuffer = buffers[0];
+    u8 back = 0;
+    u8 front = 1;
+    std::atomic<u8> middle { 2 };
 
     bool amphy_quit = false;
     SDL_Event e;
@@ -52,15 +71,27 @@ class Display
 
     bool cleared = false;
 
+    // Frames rendered so far
+    u64 frames = 0;
+
   private:
     bool LoadSplash();
     void ApplyImg();
 
+    // Present thread, woken when a frame is published
+    std::thread presenter;
+    std::atomic<bool> presenting { false };
+    std::mutex presentMutex;
+    std::condition_variable presentCv;
+    void Present_Loop();
+
   public:
     bool Init();
     void Close();
     void HandleEvent();
+    void WaitEvent(int ms);
     void DrawPixel(u16 x, u16 y, Color * c);
+    u32 * Line(u16 y) { return framebuffer + y * SCREEN_WIDTH; }
     void Render();
     void Clear(Color * c);
 };
@@ -2,13 +2,31 @@
 /* █▀█ █░░ ▄▀█ ▀█▀ █▀▀ █▀█ █▀█ █▀▄▀█ */
 /* █▀▀ █▄▄ █▀█ ░█░ █▀░ █▄█ █▀▄ █░▀░█ */
 
-// eventually this #define will be moved to the makefile,
-// but idk how to do that yet lol
-#define PLATFORM_LINUX
+// Every platform provides a Display class with the same members:
+// Init, Close, HandleEvent, WaitEvent, DrawPixel, Line, Render, Clear,
+// and the amphy_quit, cleared and frames fields.
+//
+// The SDL display is the default. `make headless` defines
+// PLATFORM_HEADLESS instead and builds without SDL.
+#if !defined(PLATFORM_HEADLESS) && !defined(PLATFORM_ESP32)
+  #define PLATFORM_LINUX
+#endif
+
+// Size of the Game Boy screen
+#define SCREEN_WIDTH 160
+#define SCREEN_HEIGHT 144
+
+// Longest WaitEvent sleeps with no input, so a quit request is still
+// noticed while idle
+#define IDLE_WAIT_MS 50
 
 #ifdef PLATFORM_LINUX
   #include "linux/display.h"
 #endif
 
+#ifdef PLATFORM_HEADLESS
+  #include "headless/display.h"
+#endif
+
 #ifdef PLATFORM_ESP32
 #endif
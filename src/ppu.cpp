@@ -7,6 +7,7 @@
 #include "common.h"
 #include "ppu.h"
 #include "bus.h"
+#include "gfx.h"
 #include "platform/platform.h"
 
 /*                  240                       68
@@ -35,6 +36,13 @@ Color color_3 = {0x08, 0x18, 0x20};
 
 Color Ppu::gb_colors[4] = { color_0, color_1, color_2, color_3 };
 
+/* Scheduler callback */
+static void Ppu_Event(void * ctx) {
+  Ppu * ppu = (Ppu *) ctx;
+  ppu->Sync();
+  ppu->Schedule();
+}
+
 void Ppu::Init() {
   ly    = bus->GetAddressPointer(LY);
   wx    = bus->GetAddressPointer(WX);
@@ -48,18 +56,30 @@ void Ppu::Init() {
   obp0  = bus->GetAddressPointer(0xFF48);
   obp1  = bus->GetAddressPointer(0xFF49);
   lyc   = bus->GetAddressPointer(0xFF45);
+  vram  = bus->GetAddressPointer(VRAM_START);
+  oam   = bus->GetAddressPointer(OAM_START);
+
+  Gfx_Init();
+  tiles.Init(vram);
+  Gfx_PaletteLut(0b11100100, gb_colors, shadeLut);
   *ly   = 0;
-  spritesOnScanline.clear();
+  spriteCount = 0;
   disp->Clear(&gb_colors[0]);
+
+  sched->Register(EV_PPU, Ppu_Event, this);
+  Schedule();
 }
 
-/* @Function Ppu::Execute
- * @param cpuCyclesElapsed
- * @brief Runs PPU until it catches up to the CPU. 
- *    1 dot == 1 t-cycle. Normally when this is called,
- *    cpuCyclesElapsed == 4, so the state machine should
- *    tick 4 times. */
-void Ppu::Execute(u8 cpuCyclesElapsed) {
+/* @Function Ppu::Sync
+ * @brief Runs the PPU until it catches up to the CPU. 
+ *    1 dot == 1 t-cycle. Pixel transfer runs dot by dot; OAM scan
+ *    and the idle stretches of HBlank and VBlank are skipped in
+ *    one step. Called by the PPU event and by the bus before the CPU
+ *    writes anything the PPU reads (VRAM, OAM, FF40-FF4B), so the
+ *    PPU can otherwise fall behind for a whole mode. */
+void Ppu::Sync() {
+  u64 now = sched->now;
+
   // Display white
   if (BIT_TEST(*lcdc, LCDC_EN) == false) {
     if (disp->cleared == false) {
@@ -67,76 +87,168 @@ void Ppu::Execute(u8 cpuCyclesElapsed) {
     }
   }
 
-  for (u8 i = 0; i < cpuCyclesElapsed; i++) {
-    u8 nextState = NO_TRANSITION;
-
-    switch (ppuState) {
-      case OAM_SCAN:
-        OAMScan(&nextState);
-        break;
-      case PIXEL_TRANSFER:
-        PixelTransfer(&nextState);
-        break;
-      case HBLANK:
-        HBlank(&nextState);
-        break;
-      case VBLANK:
-        VBlank(&nextState);
-        break;
-      default: break;
+  while (dotClock < now) {
+    u64 idle = IdleDots();
+
+    if (idle) {
+      if (idle > now - dotClock) idle = now - dotClock;
+      dotClock += idle;
+      dotsSinceStateSwitch += idle;
+      CheckLyc();
+    } else {
+      Dot();
+      dotClock++;
     }
+  }
+}
 
-    dotsSinceStateSwitch++;
+/* @Function Ppu::Schedule
+ * @brief Set the PPU event for the next dot the CPU could notice
+ *    without touching PPU memory: a mode or LY change, which can
+ *    request interrupts and ends the frame. STAT and LY only change
+ *    there, so reads need no catch-up. While LY == LYC the STAT
+ *    interrupt is requested on every dot, so the PPU is woken every
+ *    m-cycle. */
+void Ppu::Schedule() {
+  sched->Schedule(EV_PPU, IrqDeadline());
+}
 
-    // Handle STAT LY=LYC interrupt
-    if (*ly == *lyc && BIT_TEST(*stat, STAT_LYC_INTR)) {
-      *intf = BIT_SET(*intf, INTF_STAT_IRQ);
-    }
+/* @Function Ppu::IrqDeadline
+ * @brief First dot that could request an interrupt: the next state
+ *    transition or LY change, or the next dot while LY == LYC is
+ *    armed. Nothing else can touch the PPU while the CPU is halted,
+ *    so everything up to this dot can be run in one go. */
+u64 Ppu::IrqDeadline() {
+  if (*ly == *lyc && BIT_TEST(*stat, STAT_LYC_INTR)) return dotClock + 1;
+  return NextTransition();
+}
 
-    // Set variables and interrupts for state transitions
-    if (nextState != NO_TRANSITION) {
-      // STAT mode flags
-      // Need to decrement nextState because enum is offset
-      // by 1 (0 == NoTransition)
-      *stat = (*stat & 0xFC) | (nextState - 1);
-
-      u8 setStatIntr = false;
-
-      if (nextState == OAM_SCAN) {
-        x = 0;
-        (*ly)++;
-        spritesOnScanline.clear();
-        if (BIT_TEST(*stat, STAT_OAM_INTR)) setStatIntr = true;
-
-        if (ppuState == VBLANK) {
-          *ly = 0;
-          cnt = 226;
-        }
-      }
+/* @Function Ppu::NextTransition
+ * @brief First dot at which the STAT mode or LY changes. */
+u64 Ppu::NextTransition() {
+  switch (ppuState) {
+    case OAM_SCAN:
+      return dotClock + (DOTS_OAM - dotsSinceStateSwitch) + 1;
+    case PIXEL_TRANSFER:
+      return dotClock + (DOTS_PXTRANSFER - dotsSinceStateSwitch) + 1;
+    default:
+      return dotClock + IdleDots() + 1;
+  }
+}
 
-      if (nextState == VBLANK) {
-        *intf = BIT_SET(*intf, INTF_VBLANK_IRQ);
-        if (BIT_TEST(*stat, STAT_VBLANK_INTR)) setStatIntr = true;
-        wcnt = 0;
-        disp->HandleEvent();
-        disp->Render();
-      }
+/* @Function Ppu::NextLyChange
+ * @brief First dot at which LY changes. LY moves on at the end of
+ *    HBlank and every scanline of VBlank. */
+u64 Ppu::NextLyChange() {
+  switch (ppuState) {
+    case OAM_SCAN:
+      return NextTransition() + (DOTS_PXTRANSFER + 1) + (DOTS_HBLANK + 1);
+    case PIXEL_TRANSFER:
+      return NextTransition() + (DOTS_HBLANK + 1);
+    default:
+      return NextTransition();
+  }
+}
 
-      if (nextState == HBLANK) {
-        if (renderedWindow) wcnt++;
-        renderedWindow = false;
-        if (BIT_TEST(*stat, STAT_HBLANK_INTR)) setStatIntr = true;
-      }
+/* @Function Ppu::IdleDots
+ * @brief Number of upcoming dots that do nothing but count. */
+u16 Ppu::IdleDots() {
+  switch (ppuState) {
+    case OAM_SCAN:
+      // The scan is done as the mode starts
+      return DOTS_OAM - dotsSinceStateSwitch;
+    case HBLANK:
+      return DOTS_HBLANK - dotsSinceStateSwitch;
+    case PIXEL_TRANSFER:
+      // The scanline renderer draws everything on the last dot
+      if (!lineRender) return 0;
+      return DOTS_PXTRANSFER - dotsSinceStateSwitch;
+    case VBLANK:
+      if (dotsSinceStateSwitch % DOTS_VBLANK_SCANLINE == 0) return 0;
+      return DOTS_VBLANK_SCANLINE - (dotsSinceStateSwitch % DOTS_VBLANK_SCANLINE);
+    default:
+      return 0;
+  }
+}
+
+/* @Function Ppu::CheckLyc
+ * @brief Handle STAT LY=LYC interrupt */
+void Ppu::CheckLyc() {
+  if (*ly == *lyc && BIT_TEST(*stat, STAT_LYC_INTR)) {
+    *intf = BIT_SET(*intf, INTF_STAT_IRQ);
+  }
+}
+
+/* @Function Ppu::Dot
+ * @brief Run the state machine for one dot. */
+void Ppu::Dot() {
+  u8 nextState = NO_TRANSITION;
+
+  switch (ppuState) {
+    case OAM_SCAN:
+      OAMScan(&nextState);
+      break;
+    case PIXEL_TRANSFER:
+      PixelTransfer(&nextState);
+      break;
+    case HBLANK:
+      HBlank(&nextState);
+      break;
+    case VBLANK:
+      VBlank(&nextState);
+      break;
+    default: break;
+  }
+
+  dotsSinceStateSwitch++;
+
+  CheckLyc();
+
+  // Set variables and interrupts for state transitions
+  if (nextState != NO_TRANSITION) {
+    // STAT mode flags
+    // Need to decrement nextState because enum is offset
+    // by 1 (0 == NoTransition)
+    *stat = (*stat & 0xFC) | (nextState - 1);
+
+    u8 setStatIntr = false;
 
-      if (nextState == PIXEL_TRANSFER) {
-        // wcnt = 0;
-        // doDrawWindow = false;
+    if (nextState == OAM_SCAN) {
+      x = 0;
+      (*ly)++;
+      if (BIT_TEST(*stat, STAT_OAM_INTR)) setStatIntr = true;
+
+      if (ppuState == VBLANK) {
+        *ly = 0;
+        cnt = 226;
       }
 
-      if (setStatIntr) *intf = BIT_SET(*intf, INTF_STAT_IRQ);
-      ppuState = nextState;
-      dotsSinceStateSwitch = 0;
+      Sprites_Scan();
+    }
+
+    if (nextState == VBLANK) {
+      *intf = BIT_SET(*intf, INTF_VBLANK_IRQ);
+      if (BIT_TEST(*stat, STAT_VBLANK_INTR)) setStatIntr = true;
+      wcnt = 0;
+      disp->HandleEvent();
+      disp->Render();
+      bus->Save_Tick();
+    }
+
+    if (nextState == HBLANK) {
+      if (renderedWindow) wcnt++;
+      renderedWindow = false;
+      if (BIT_TEST(*stat, STAT_HBLANK_INTR)) setStatIntr = true;
+    }
+
+    if (nextState == PIXEL_TRANSFER) {
+      // wcnt = 0;
+      // doDrawWindow = false;
     }
+
+    if (setStatIntr) *intf = BIT_SET(*intf, INTF_STAT_IRQ);
+    ppuState = nextState;
+    dotsSinceStateSwitch = 0;
   }
 }
 
@@ -154,44 +266,81 @@ void Ppu::UpdateCycles(u8 state)
 
 /* @Function Ppu::OAMScan
  * @brief Search through OAM (object access memory) for sprites to draw.
- *    Up to 10 sprites can be drawn per scanline. Excess sprites are ignored.
- *    40 sprites/160 bytes in OAM. Function is called 40 times. */
+ *    The search itself is done in one pass by Sprites_Scan when the
+ *    mode starts; this waits out the rest of the 80 dots. */
 void Ppu::OAMScan(u8 *nextState) {
-  // One sprite takes 2 dots to check
-  if (dotsSinceStateSwitch % 2 != 0) return;
+  if (dotsSinceStateSwitch == DOTS_OAM) {
+    *nextState = PIXEL_TRANSFER;
+    Sprites_Load();
+  }
+}
 
-  // Keep track of which of the 40 sprites we are checking
-  static u8 spriteIndex = 0;
+/* @Function Ppu::Sprites_Scan
+ * @brief Find the sprites on the current scanline. Up to 10 sprites
+ *    can be drawn per scanline; excess sprites are ignored. All 40 Y
+ *    positions are compared at once. */
+void Ppu::Sprites_Scan() {
+  u8 spriteHeight = BIT_TEST(*lcdc, LCDC_OBJ_SIZE) ? 16 : 8;
+  u64 hits = gfx.ScanOam(oam, *ly, spriteHeight);
 
-  // Size of sprite is 4 bytes, byte 0 is y pos+16
-  Address addr = OAM_START + (spriteIndex * 4);
-  u8 ypos = bus->Read(addr) - 16;
+  spriteCount = 0;
+  while (hits && spriteCount < SPRITES_PER_LINE) {
+    spriteSlots[spriteCount++] = __builtin_ctzll(hits);
+    hits &= hits - 1;
+  }
+}
 
-  // Check if sprite is on current scanline
-  u8 spriteHeight = BIT_TEST(*lcdc, LCDC_OBJ_SIZE) ? 16 : 8;
-  bool onScanline = ypos <= *ly && ypos+spriteHeight > *ly;
-  if (onScanline && spritesOnScanline.size() < 10) {
-    spritesOnScanline.push_back(addr);
+/* @Function Ppu::Sprites_Load
+ * @brief Read the OAM entries of the sprites found by OAM scan into
+ *    records sorted by X, lower first, then by OAM slot, and mark the
+ *    pixels they cover. A pixel belongs to the first record covering
+ *    it. Sprites left of X = 8 are never drawn. */
+void Ppu::Sprites_Load() {
+  for (u8 i = 0; i < spriteCount; i++) {
+    Address addr = OAM_START + spriteSlots[i] * 4;
+    Sprite s;
+    s.y    = bus->Read(addr + OAM_YPOS);
+    s.x    = bus->Read(addr + OAM_XPOS) - 8;
+    s.tile = bus->Read(addr + OAM_TIDX);
+    s.attr = bus->Read(addr + OAM_ATTR);
+    s.slot = spriteSlots[i];
+
+    // Insertion sort; slots arrive in increasing order
+    u8 j = i;
+    while (j > 0 && sprites[j - 1].x > s.x) {
+      sprites[j] = sprites[j - 1];
+      j--;
+    }
+    sprites[j] = s;
   }
-    
-  ++spriteIndex;
-  if (dotsSinceStateSwitch == DOTS_OAM) {
-    spriteIndex = 0;
-    *nextState = PIXEL_TRANSFER;
 
-    // TODO Sort by x coordinate, lower comes first
-    // sort(spritesOnScanline.begin(), spritesOnScanline.end(),
-    //     [this](const u8 & a, u8 & b) -> bool
-    //     {
-    //       return bus->Read(a+OAM_XPOS) < bus->Read(b+OAM_XPOS);
-    //     });
+  spriteMask[0] = spriteMask[1] = spriteMask[2] = 0;
+  for (u8 i = 0; i < spriteCount; i++) {
+    for (int px = sprites[i].x; px < sprites[i].x + 8 && px < SCREEN_WIDTH; px++) {
+      spriteMask[px >> 6] |= 1ULL << (px & 63);
+    }
   }
 }
 
+/* @Function Ppu::OamWritten
+ * @brief Called by the bus after an OAM write. The records are only
+ *    used during pixel transfer, so reload them if it is running. */
+void Ppu::OamWritten() {
+  if (ppuState == PIXEL_TRANSFER) Sprites_Load();
+}
+
 /* @Function Ppu::PixelTransfer
  * @brief Draw pixels to the screen. */
 void Ppu::PixelTransfer(u8 *nextState)
 {
+  if (lineRender) {
+    if (dotsSinceStateSwitch == DOTS_PXTRANSFER) {
+      if (BIT_TEST(*lcdc, LCDC_EN)) RenderLine();
+      *nextState = HBLANK;
+    }
+    return;
+  }
+
   if (BIT_TEST(*lcdc, LCDC_EN) == false) {
     ++x;
     if (dotsSinceStateSwitch == DOTS_PXTRANSFER) {
@@ -212,7 +361,7 @@ void Ppu::PixelTransfer(u8 *nextState)
   }
 
   bool drewSprite = false;
-  if (objEn && spritesOnScanline.size() != 0) {
+  if (objEn && spriteCount != 0) {
     drewSprite = Px_RenderSprite();
   }
 
@@ -224,6 +373,25 @@ void Ppu::PixelTransfer(u8 *nextState)
   }
 }
 
+/* @Function Ppu::TileRow
+ * @brief Color indices of the 8 pixels of the tile row at addr, left
+ *    to right. Sprites can only point outside tile data through odd
+ *    size changes mid-line; those rows are decoded from the bus. */
+const u8 * Ppu::TileRow(Address addr, bool xflip) {
+  u16 offset = addr - VRAM_START;
+  if (offset < TILE_DATA_SIZE && !(offset & 1)) {
+    return tiles.Row(offset, xflip);
+  }
+
+  u8 lo = bus->Read(addr);
+  u8 hi = bus->Read(addr + 1);
+  for (u8 col = 0; col < 8; col++) {
+    u8 bit = xflip ? col : 7 - col;
+    tileScratch[col] = (BIT_GET(hi, bit) << 1) | BIT_GET(lo, bit);
+  }
+  return tileScratch;
+}
+
 /* @Function Ppu::Px_RenderBgWindo
  * @brief Render a background or window pixel */
 bool Ppu::Px_RenderBgWindow(void) {
@@ -262,14 +430,12 @@ bool Ppu::Px_RenderBgWindow(void) {
   }
 
   // Get x and y coordinates within 8x8 tile
-  u8 tile_x = 7 - thisX % 8;
+  u8 tile_x = thisX % 8;
   u8 tile_y = thisY % 8;
   tdata_addr += (tile_y * 2);
 
   // Determine color
-  u8 lsbit = BIT_GET(bus->Read(tdata_addr), tile_x);
-  u8 msbit = BIT_GET(bus->Read(tdata_addr+1), tile_x);
-  u8 id = (msbit << 1) | lsbit;
+  u8 id = TileRow(tdata_addr, false)[tile_x];
 
   // Apply color (also used in RenderSprite)
   bgPalette = (*bgp >> (id * 2)) & 0b11;
@@ -281,32 +447,24 @@ bool Ppu::Px_RenderBgWindow(void) {
 
 /* @Function Ppu::RenderSprite */
 bool Ppu::Px_RenderSprite(void) {
-  // All sprites on scanline are stored in spritesOnScanline vec
-  // Find the one with the lowest x coordinate
-  u8 idx = 0xFF; // Value if sprite not found
-  u8 idx_X = 0;
-  for (u8 i = 0; i < spritesOnScanline.size(); i++) {
-    Address oamAddr = spritesOnScanline[i];
-    u8 spriteX = bus->Read(oamAddr + OAM_XPOS) - 8;
-    bool inRange = spriteX <= x && spriteX+8 > x;
-    bool spriteFoundShouldReplace = idx != 0xFF && spriteX < idx_X;
-    if (inRange && (idx == 0xFF || spriteFoundShouldReplace)) {
-      idx = i;
-      idx_X = spriteX;
-    }
-  }
-  if (idx == 0xFF) return false;
+  // Pixels no sprite covers are skipped without a search
+  if (x >= SCREEN_WIDTH) return false;
+  if (((spriteMask[x >> 6] >> (x & 63)) & 1) == 0) return false;
+
+  // Records are sorted by X, so the first one in range is the sprite
+  // with the lowest x coordinate
+  u8 idx = 0;
+  while (!(sprites[idx].x <= x && sprites[idx].x + 8 > x)) idx++;
+  const Sprite & s = sprites[idx];
 
   // Now find the tile data address
-  // Byte 2 of sprite data is tile index
-  Address oamAddr = spritesOnScanline[idx];
-  u8 tileIndex = bus->Read(oamAddr + OAM_TIDX);
+  u8 tileIndex = s.tile;
   
   // One tile is 16 bytes; use current y position within the sprite
   // to find the correct 2 bytes to read from
-  u16 cur_y_pos = *ly - bus->Read(oamAddr) + 16;
+  u16 cur_y_pos = *ly - s.y + 16;
  
-  u8 attr = bus->Read(oamAddr + OAM_ATTR);
+  u8 attr = s.attr;
 
   // Handle vertical flip
   if (BIT_TEST(attr, OAM_ATTR_YFLIP)) {
@@ -329,17 +487,10 @@ bool Ppu::Px_RenderSprite(void) {
   tdataAddr += (cur_y_pos * 2);
 
   // Find correct column within tile
-  u8 cur_x_pos = x - bus->Read(oamAddr+1) + 8;
-  u8 bitpos = 7 - cur_x_pos;
-
+  u8 cur_x_pos = x - s.x;
   // Handle horizontal flip
-  if (BIT_TEST(attr, OAM_ATTR_XFLIP)) {
-    bitpos = 7 - bitpos;
-  }
-
-  u8 lsbit = BIT_GET(bus->Read(tdataAddr), bitpos);
-  u8 msbit = BIT_GET(bus->Read(tdataAddr+1), bitpos);
-  u8 id = (msbit << 1) | lsbit;
+  bool xflip = BIT_TEST(attr, OAM_ATTR_XFLIP);
+  u8 id = TileRow(tdataAddr, xflip)[cur_x_pos];
 
   // Apply color
   u8 palette = BIT_TEST(attr, OAM_ATTR_PALETTE) ? *obp1 : *obp0;
@@ -359,6 +510,155 @@ bool Ppu::Px_RenderSprite(void) {
   return true;
 }
 
+/* █▀ █▀▀ ▄▀█ █▄░█ █░░ █ █▄░█ █▀▀ */
+/* ▄█ █▄▄ █▀█ █░▀█ █▄▄ █ █░▀█ ██▄ */
+
+/* The scanline renderer computes the same pixels as Px_RenderBgWindow
+ * and Px_RenderSprite, one layer at a time across the whole line. */
+
+/* @Function Ppu::RenderLine
+ * @brief Draw all 160 pixels of the current scanline. */
+void Ppu::RenderLine() {
+  // LY can be written out of range; there is no row to draw into
+  if (*ly >= SCREEN_HEIGHT) return;
+
+  bool objEn = BIT_TEST(*lcdc, LCDC_OBJ_EN);
+
+  // Palette-mapped colors per layer. Sprites use 0xFF for no pixel.
+  u8 bgPal[SCREEN_WIDTH] = {};
+  u8 objPal[SCREEN_WIDTH];
+  memset(objPal, 0xFF, sizeof(objPal));
+
+  bool drewBg = Line_BgWindow(bgPal);
+
+  if (objEn && spriteCount != 0) {
+    Line_Sprites(bgPal, objPal);
+  }
+
+  u8 line[SCREEN_WIDTH];
+  for (u16 px = 0; px < SCREEN_WIDTH; px++) {
+    if (objPal[px] != 0xFF) {
+      line[px] = objPal[px];
+    } else if (drewBg) {
+      line[px] = bgPal[px];
+    } else {
+      line[px] = 0;
+    }
+  }
+
+  gfx.Map(line, shadeLut, disp->Line(*ly), SCREEN_WIDTH);
+}
+
+/* @Function Ppu::Line_BgWindow
+ * @brief Background and window layer. Tile rows are only fetched when
+ *    the line moves on to the next tile. Returns false if neither
+ *    layer is enabled. */
+bool Ppu::Line_BgWindow(u8 * pal) {
+  bool winEn = BIT_TEST(*lcdc, LCDC_WIN_EN);
+  bool bgEn  = BIT_TEST(*lcdc, LCDC_BG_EN);
+  if (!bgEn && !winEn) return false;
+
+  bool winLine = winEn && *wy <= *ly;
+  int winStart = *wx - 7;
+
+  // The per-dot path runs x up to DOTS_PXTRANSFER, past the edge of
+  // the screen, and counts the window line from there too
+  if (winLine && winStart <= DOTS_PXTRANSFER) renderedWindow = true;
+
+  u16 winBase = BIT_TEST(*lcdc, LCDC_WIN_TMAP) ? 0x9C00 : 0x9800;
+  u16 bgBase  = BIT_TEST(*lcdc, LCDC_BG_TMAP) ? 0x9C00 : 0x9800;
+  bool unsignedAddressing = BIT_TEST(*lcdc, LCDC_BGW_ADDR_MODE);
+
+  u16 rowAddr = 0;
+  const u8 * row = NULL;
+
+  for (u16 px = 0; px < SCREEN_WIDTH; px++) {
+    u8 tmap_x, tmap_y;
+    u16 tmap_base;
+
+    if (winLine && winStart <= px) {
+      tmap_x = px + 7 - *wx;
+      tmap_y = wcnt;
+      tmap_base = winBase;
+    } else {
+      tmap_x = *scx + px;
+      tmap_y = *scy + *ly;
+      tmap_base = bgBase;
+    }
+
+    u16 tmap_addr = tmap_base | (((tmap_y / 8) * 32) + (tmap_x / 8));
+    u8 tile_index = vram[tmap_addr - VRAM_START];
+
+    u16 tdata_addr;
+    if (unsignedAddressing) {
+      tdata_addr = 0x8000 + (tile_index * 16);
+    } else {
+      tdata_addr = 0x9000 + ((int8_t) tile_index * 16);
+    }
+    tdata_addr += (tmap_y % 8) * 2;
+
+    if (px == 0 || tdata_addr != rowAddr) {
+      rowAddr = tdata_addr;
+      row = tiles.Row(tdata_addr - VRAM_START, false);
+    }
+
+    u8 id = row[tmap_x % 8];
+    pal[px] = (*bgp >> (id * 2)) & 0b11;
+  }
+
+  return true;
+}
+
+/* @Function Ppu::Line_Sprites
+ * @brief Sprite layer. Each pixel belongs to the first sprite record
+ *    covering it, and stays empty if that sprite is transparent or
+ *    behind the background there. */
+void Ppu::Line_Sprites(const u8 * bgPal, u8 * pal) {
+  bool tall = BIT_TEST(*lcdc, LCDC_OBJ_SIZE);
+  u64 claimed[3] = { 0, 0, 0 };
+
+  for (u8 i = 0; i < spriteCount; i++) {
+    const Sprite & s = sprites[i];
+    u8 tileIndex = s.tile;
+    u16 cur_y_pos = *ly - s.y + 16;
+
+    if (BIT_TEST(s.attr, OAM_ATTR_YFLIP)) {
+      u8 objSize = tall ? 16 : 8;
+      cur_y_pos = objSize - 1 - cur_y_pos;
+    }
+
+    if (tall) {
+      if (cur_y_pos >= 8) {
+        tileIndex &= 0xFE;
+      } else {
+        tileIndex |= 0x01;
+        cur_y_pos -= 8;
+      }
+    }
+
+    Address tdataAddr = 0x8000 | (tileIndex * 16);
+    tdataAddr += (cur_y_pos * 2);
+    bool xflip = BIT_TEST(s.attr, OAM_ATTR_XFLIP);
+    const u8 * row = TileRow(tdataAddr, xflip);
+
+    u8 palette = BIT_TEST(s.attr, OAM_ATTR_PALETTE) ? *obp1 : *obp0;
+    bool bgPriority = BIT_TEST(s.attr, OAM_ATTR_BG_PRIORITY);
+
+    for (int px = s.x; px < s.x + 8 && px < SCREEN_WIDTH; px++) {
+      u64 bit = 1ULL << (px & 63);
+      if (claimed[px >> 6] & bit) continue;
+      claimed[px >> 6] |= bit;
+
+      u8 id = row[px - s.x];
+      u8 paletteID = ((palette & 0xFC) >> (id * 2)) & 0b11;
+
+      if (paletteID == 0) continue;
+      if (bgPriority && bgPal[px] != 0) continue;
+      pal[px] = paletteID;
+    }
+  }
+}
+
 /* Ppu::HBlank */
 void Ppu::HBlank(u8 *nextState) {
   // if (*ly == *wy) doDrawWindow = true;
@@ -5,9 +5,10 @@
 #ifndef PPU_H
 #define PPU_H
 
-#include <SDL2/SDL.h>
 #include "bus.h"
 #include "cpu.h"
+#include "scheduler.h"
+#include "tiles.h"
 #include "platform/platform.h"
 
 #define DOTS_OAM 80
@@ -19,6 +20,9 @@
 
 #define OAM_BYTES   40
 
+// Sprites drawn per scanline; later ones in OAM are ignored
+#define SPRITES_PER_LINE 10
+
 #define NO_TRANSITION 0
 
 #define OAM_YPOS 0
@@ -56,6 +60,15 @@ static const u8 PPU_STATE_CYCLES[5] = {
   4,  // PxTransfer
 };
 
+// A sprite found by OAM scan, with its OAM bytes read ahead
+typedef struct Sprite {
+  u8 y;     // top line + 16, as in OAM
+  u8 x;     // left column (OAM X - 8)
+  u8 tile;
+  u8 attr;
+  u8 slot;  // index in OAM, breaks ties in X
+} Sprite;
+
 class Ppu
 {
   private:
@@ -74,6 +87,9 @@ class Ppu
 
     u16 dotsSinceStateSwitch = 0;
 
+    // Last dot the PPU ran, in the scheduler's cycle count
+    u64 dotClock = 0;
+
     // Pointers to commonly used registers
     // saves me some keystrokes
     u8 * ly;
@@ -93,7 +109,15 @@ class Ppu
 
     static Color gb_colors[4];
    
-    std::vector<u16> spritesOnScanline;
+    // Sprites on the current line: OAM slots in scan order, then
+    // their records sorted by X and the pixels they cover
+    u8 spriteSlots[SPRITES_PER_LINE];
+    u8 spriteCount = 0;
+    Sprite sprites[SPRITES_PER_LINE];
+    u64 spriteMask[3]; // 160 bits
+    u8 * oam;
+    void Sprites_Scan();
+    void Sprites_Load();
 
     // PPU state machine
     void OAMScan(u8 *nextState);
@@ -105,11 +129,38 @@ class Ppu
     bool Px_RenderSprite(void);
     u8 bgPalette;
 
+    const u8 * TileRow(Address addr, bool xflip);
+    u8 tileScratch[8];
+
+    // Scanline renderer
+    u8 * vram;
+    u32 shadeLut[4];
+    void RenderLine();
+    bool Line_BgWindow(u8 * pal);
+    void Line_Sprites(const u8 * bgPal, u8 * pal);
+
     void UpdateCycles(u8 state);
 
+    void Dot();
+    u16 IdleDots();
+    void CheckLyc();
+
   public:
+    Scheduler * sched;
+    TileCache tiles;
+
+    // Render whole scanlines at the end of pixel transfer instead of
+    // one pixel per dot. Register changes during the line are only
+    // seen at the end of it.
+    bool lineRender = false;
+
     void Init();
-    void Execute(u8 cpuCyclesElapsed);
+    void Sync();
+    void OamWritten();
+    void Schedule();
+    u64 IrqDeadline();
+    u64 NextTransition();
+    u64 NextLyChange();
     int cnt = 144; // ???
 
     // Constructor & destructor
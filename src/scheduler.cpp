@@ -0,0 +1,102 @@
+
+/* █▀ █▀▀ █░█ █▀▀ █▀▄ █░█ █░░ █▀▀ █▀█ */
+/* ▄█ █▄▄ █▀█ ██▄ █▄▀ █▄█ █▄▄ ██▄ █▀▄ */
+
+#include "scheduler.h"
+
+/* @Function Scheduler::Register
+ * @brief Set the function to call when ev comes due. */
+void Scheduler::Register(EventType ev, EventCallback fn, void * ctx) {
+  events[ev].fn = fn;
+  events[ev].ctx = ctx;
+}
+
+/* @Function Scheduler::Schedule
+ * @brief Set (or move) the deadline for ev. */
+void Scheduler::Schedule(EventType ev, u64 when) {
+  Event * e = &events[ev];
+
+  if (e->pos < 0) {
+    e->pos = heapSize;
+    heap[heapSize++] = ev;
+    e->when = when;
+    SiftUp(e->pos);
+  } else {
+    u64 old = e->when;
+    e->when = when;
+    if (when < old) SiftUp(e->pos);
+    else SiftDown(e->pos);
+  }
+
+  next = events[heap[0]].when;
+}
+
+/* @Function Scheduler::Cancel */
+void Scheduler::Cancel(EventType ev) {
+  if (events[ev].pos < 0) return;
+  Remove(ev);
+  next = heapSize ? events[heap[0]].when : EV_NEVER;
+}
+
+/* @Function Scheduler::Run
+ * @brief Dispatch every event that is due. Handlers see the current
+ *    `now` and usually reschedule themselves. */
+void Scheduler::Run() {
+  while (heapSize && events[heap[0]].when <= now) {
+    EventType ev = (EventType) heap[0];
+    Remove(ev);
+    events[ev].fn(events[ev].ctx);
+  }
+
+  next = heapSize ? events[heap[0]].when : EV_NEVER;
+}
+
+void Scheduler::Remove(EventType ev) {
+  u8 i = events[ev].pos;
+  events[ev].pos = -1;
+  events[ev].when = EV_NEVER;
+
+  --heapSize;
+  if (i == heapSize) return;
+
+  heap[i] = heap[heapSize];
+  events[heap[i]].pos = i;
+  SiftUp(i);
+  SiftDown(events[heap[i]].pos);
+}
+
+/* Earlier deadline first, ties go to the lower event type */
+bool Scheduler::Before(u8 a, u8 b) {
+  if (events[a].when != events[b].when) return events[a].when < events[b].when;
+  return a < b;
+}
+
+void Scheduler::Swap(u8 i, u8 j) {
+  u8 tmp = heap[i];
+  heap[i] = heap[j];
+  heap[j] = tmp;
+  events[heap[i]].pos = i;
+  events[heap[j]].pos = j;
+}
+
+void Scheduler::SiftUp(u8 i) {
+  while (i > 0) {
+    u8 parent = (i - 1) / 2;
+    if (!Before(heap[i], heap[parent])) break;
+    Swap(i, parent);
+    i = parent;
+  }
+}
+
+void Scheduler::SiftDown(u8 i) {
+  while (true) {
+    u8 l = 2 * i + 1;
+    u8 r = l + 1;
+    u8 min = i;
+    if (l < heapSize && Before(heap[l], heap[min])) min = l;
+    if (r < heapSize && Before(heap[r], heap[min])) min = r;
+    if (min == i) break;
+    Swap(i, min);
+    i = min;
+  }
+}
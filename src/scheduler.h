@@ -0,0 +1,60 @@
+
+/* █▀ █▀▀ █░█ █▀▀ █▀▄ █░█ █░░ █▀▀ █▀█ */
+/* ▄█ █▄▄ █▀█ ██▄ █▄▀ █▄█ █▄▄ ██▄ █▀▄ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstddef>
+#include "common.h"
+
+#define EV_NEVER UINT64_MAX
+
+/* Event types. When two events are due on the same cycle they run
+ * in this order, which matches the order Tick used to step things. */
+typedef enum EventType {
+  EV_TIMER,
+  EV_PPU,
+  EV_DMA,
+  EV_SERIAL,
+  EV_TYPES,
+} EventType;
+
+typedef void (*EventCallback)(void * ctx);
+
+/* Global cycle counter plus a min-heap of per-subsystem deadlines.
+ * Each event type has at most one pending deadline. The CPU advances
+ * `now` and only calls Run() once the earliest deadline is reached,
+ * so subsystems with nothing to do cost nothing per access. */
+class Scheduler
+{
+  private:
+    struct Event {
+      u64 when = EV_NEVER;
+      EventCallback fn = NULL;
+      void * ctx = NULL;
+      int8_t pos = -1; // index in heap, -1 if not scheduled
+    } events[EV_TYPES];
+
+    u8 heap[EV_TYPES];
+    u8 heapSize = 0;
+
+    bool Before(u8 a, u8 b);
+    void Swap(u8 i, u8 j);
+    void SiftUp(u8 i);
+    void SiftDown(u8 i);
+    void Remove(EventType ev);
+
+  public:
+    u64 now  = 0;        // t-cycles since power on
+    u64 next = EV_NEVER; // earliest deadline
+
+    void Register(EventType ev, EventCallback fn, void * ctx);
+    void Schedule(EventType ev, u64 when);
+    void Cancel(EventType ev);
+    void Run();
+
+    u64 Deadline(EventType ev) { return events[ev].when; }
+};
+
+#endif
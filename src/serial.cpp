@@ -0,0 +1,74 @@
+
+/* █▀ █▀▀ █▀█ █ ▄▀█ █░░ */
+/* ▄█ ██▄ █▀▄ █ █▀█ █▄▄ */
+
+#include <stdio.h>
+#include "serial.h"
+#include "cpu.h"
+#include "bus.h"
+
+static void Serial_Event(void * ctx) {
+  ((Serial *) ctx)->Complete();
+}
+
+/* @Function Serial_StderrSink
+ * @brief Print bytes as they come, like Blargg's test ROMs expect. */
+void Serial_StderrSink(u8 byte, void *) {
+  fputc(byte, stderr);
+}
+
+/* @Function Serial_FileSink
+ * @brief Write bytes to an open file or pipe. Flushed per byte so a
+ *    reader on the other end sees them immediately. */
+void Serial_FileSink(u8 byte, void * ctx) {
+  FILE * f = (FILE *) ctx;
+  fputc(byte, f);
+  fflush(f);
+}
+
+/* @Function Serial_BufferSink */
+void Serial_BufferSink(u8 byte, void * ctx) {
+  ((std::string *) ctx)->push_back(byte);
+}
+
+/* @Function Serial::Init */
+void Serial::Init(Cpu * cpu_) {
+  cpu = cpu_;
+  sb = cpu->bus->GetAddressPointer(SERB);
+  sc = cpu->bus->GetAddressPointer(SERC);
+  intf = cpu->bus->GetAddressPointer(INTF);
+  cpu->sched->Register(EV_SERIAL, Serial_Event, this);
+}
+
+/* @Function Serial::AddSink */
+void Serial::AddSink(SerialSink fn, void * ctx) {
+  sinks.push_back({ fn, ctx });
+}
+
+/* @Function Serial::Control
+ * @brief Called after SC is written. Starting a transfer on the
+ *    internal clock schedules its completion on the 8th bit clock
+ *    edge; anything else stops a transfer in progress. */
+void Serial::Control(u8 val) {
+  if (!BIT_TEST(val, SERC_START) || !BIT_TEST(val, SERC_CLOCK)) {
+    cpu->sched->Cancel(EV_SERIAL);
+    return;
+  }
+
+  u64 firstEdge = SERIAL_BIT_CYCLES - (cpu->Sysclk() % SERIAL_BIT_CYCLES);
+  u64 done = cpu->sched->now + firstEdge + (SERIAL_BITS - 1) * SERIAL_BIT_CYCLES;
+  cpu->sched->Schedule(EV_SERIAL, done);
+}
+
+/* @Function Serial::Complete
+ * @brief Scheduled at the end of a transfer. */
+void Serial::Complete() {
+  for (const Sink & sink : sinks) {
+    sink.fn(*sb, sink.ctx);
+  }
+
+  // Nothing shifted in but the line's pull-up
+  *sb = 0xFF;
+  *sc = BIT_CLEAR(*sc, SERC_START);
+  *intf = BIT_SET(*intf, INTF_SRL_IRQ);
+}
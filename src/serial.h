@@ -0,0 +1,56 @@
+
+/* █▀ █▀▀ █▀█ █ ▄▀█ █░░ */
+/* ▄█ ██▄ █▀▄ █ █▀█ █▄▄ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <string>
+#include <vector>
+#include "common.h"
+
+// SC bits
+#define SERC_START 7 // transfer requested/in progress
+#define SERC_CLOCK 0 // 1: internal clock
+
+// The internal clock shifts one bit every 512 t-cycles (8192 Hz), on
+// the falling edge of bit 8 of the system counter
+#define SERIAL_BIT_CYCLES 512
+#define SERIAL_BITS 8
+
+class Cpu;
+
+// Receives every byte the Game Boy sends
+typedef void (*SerialSink)(u8 byte, void * ctx);
+
+void Serial_StderrSink(u8 byte, void * ctx);
+void Serial_FileSink(u8 byte, void * ctx);   // ctx is a FILE *
+void Serial_BufferSink(u8 byte, void * ctx); // ctx is a std::string *
+
+/* The link port with nothing plugged in. A transfer on the internal
+ * clock completes 8 bit times after it starts: the sent byte goes to
+ * the sinks, SB reads back 0xFF, and the serial interrupt is
+ * requested. On the external clock there is no one to drive it, so
+ * the transfer never completes. */
+class Serial
+{
+  private:
+    Cpu * cpu;
+    u8 * sb;
+    u8 * sc;
+    u8 * intf;
+
+    struct Sink {
+      SerialSink fn;
+      void * ctx;
+    };
+    std::vector<Sink> sinks;
+
+  public:
+    void Init(Cpu * cpu_);
+    void AddSink(SerialSink fn, void * ctx);
+    void Control(u8 val);
+    void Complete();
+};
+
+#endif
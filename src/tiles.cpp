@@ -0,0 +1,24 @@
+
+/* ▀█▀ █ █░░ █▀▀ █▀ */
+/* ░█░ █ █▄▄ ██▄ ▄█ */
+
+#include "tiles.h"
+#include "gfx.h"
+
+/* @Function TileCache::Init
+ * @brief Point the cache at VRAM. Everything starts dirty. */
+void TileCache::Init(const u8 * vram_) {
+  vram = vram_;
+  for (u16 i = 0; i < TILE_COUNT; i++) {
+    dirty[i] = true;
+  }
+}
+
+/* @Function TileCache::Decode
+ * @brief Expand one tile from 2bpp, both ways round. */
+void TileCache::Decode(u16 tile) {
+  const u8 * data = vram + tile * TILE_BYTES;
+  gfx.Decode(data, pix[tile][0], 8, false);
+  gfx.Decode(data, flip[tile][0], 8, true);
+  dirty[tile] = false;
+}
@@ -0,0 +1,45 @@
+
+/* ▀█▀ █ █░░ █▀▀ █▀ */
+/* ░█░ █ █▄▄ ██▄ ▄█ */
+
+#ifndef TILES_H
+#define TILES_H
+
+#include "common.h"
+
+// Tile data is 8000-97FF: 384 tiles of 16 bytes
+#define TILE_COUNT 384
+#define TILE_BYTES 16
+#define TILE_DATA_SIZE (TILE_COUNT * TILE_BYTES)
+
+/* Tile data expanded to one color index (0-3) per pixel, left to
+ * right, plus a mirrored copy for X-flipped sprites. Writes to tile
+ * data mark the tile dirty, and it is decoded again the next time a
+ * row of it is asked for. */
+class TileCache
+{
+  private:
+    const u8 * vram;
+    u8 pix[TILE_COUNT][8][8];
+    u8 flip[TILE_COUNT][8][8];
+    bool dirty[TILE_COUNT];
+
+    void Decode(u16 tile);
+
+  public:
+    void Init(const u8 * vram_);
+
+    // offset is from the start of VRAM
+    void Invalidate(u16 offset) { dirty[offset / TILE_BYTES] = true; }
+
+    // Row of 8 color indices for the tile data at offset (even, and
+    // below TILE_DATA_SIZE)
+    const u8 * Row(u16 offset, bool xflip) {
+      u16 tile = offset / TILE_BYTES;
+      if (dirty[tile]) Decode(tile);
+      u8 row = (offset >> 1) & 7;
+      return xflip ? flip[tile][row] : pix[tile][row];
+    }
+};
+
+#endif
@@ -4,19 +4,45 @@
 
 #include "utils.h"
 #include "bus.h"
+#include "ppu.h"
 #include <unistd.h>
+#include <stdlib.h>
 
 /* @Function ParseFlags
  * @brief Parse command line flags */
 void ParseFlags(int argc, char* argv[], Cpu* cpu) {
   /* Flags
    *  -d debug mode (step)
-   *  -g gbdoc mode */
+   *  -g gbdoc mode
+   *  -s <n> sync battery saves every n frames (0: only on RAM disable)
+   *  -e compute flags eagerly instead of lazily
+   *  -i report cycles saved by each idle loop on exit
+   *  -c disable the basic block cache
+   *  -j compile hot blocks to native code (x86-64)
+   *  -l render whole scanlines instead of one pixel per dot
+   *  -x <n> run n blocks with and without the JIT, compare, and exit
+   *  -b <n> benchmark n instructions and exit
+   *  -f <n> quit after n frames
+   *  -t <x> run at x times full speed (0: as fast as possible)
+   *  -p report frame pacing statistics on exit
+   *  -o <path> write serial output to a file or pipe instead of stderr */
   int c;
-  while ((c = getopt(argc, argv, ":dg")) != -1) {
+  while ((c = getopt(argc, argv, ":dgs:eicjlx:b:f:t:po:")) != -1) {
     switch (c) {
       case 'g': cpu->gbdoc = true; break;
       case 'd': cpu->step  = true; break;
+      case 's': cpu->bus->saveInterval = atoi(optarg); break;
+      case 'e': cpu->lazyFlags = false; break;
+      case 'i': cpu->idleReport = true; break;
+      case 'c': cpu->blockCache = false; break;
+      case 'j': cpu->useJit = true; break;
+      case 'l': cpu->ppu->lineRender = true; break;
+      case 'x': cpu->jitDiff = strtoul(optarg, NULL, 0); break;
+      case 'b': cpu->bench = strtoul(optarg, NULL, 0); break;
+      case 'f': cpu->frameLimit = strtoul(optarg, NULL, 0); break;
+      case 't': cpu->turbo = atof(optarg); break;
+      case 'p': cpu->paceReport = true; break;
+      case 'o': cpu->serialPath = optarg; break;
       default:  break;
     }
   }